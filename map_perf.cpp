@@ -1,16 +1,24 @@
 #include <cmath>
+#include <cstring>
 #include <stdio.h>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <sys/time.h>
 #endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include <iostream>
 #include <iomanip>
 #include <limits>
 #include <map>
 #include <random>
+#include <set>
 #include <string>
 #include <utility>
 #include <unordered_map>
@@ -20,6 +28,7 @@
 #include <boost/scoped_ptr.hpp>
 
 #include "static_radix_map.hpp"
+#include "static_radix_map_allocator.hpp"
 
 #define    FOR(i, m, n)    for(int i=static_cast<int>(m); i<static_cast<int>(n); ++i)
 #define    REP(i, n)        FOR(i, 0, n)
@@ -133,6 +142,57 @@ __int64 performance_timer::frequency_ = 0;
    typedef MongoTimer performance_timer;
 #endif
 
+// dTLB load misses of this thread, -1 if the counter is not available
+class tlb_counter {
+public:
+   tlb_counter() 
+      : fd_(-1)
+   {
+#ifdef __linux__
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+   }
+
+   ~tlb_counter() {
+#ifdef __linux__
+      if(fd_ >= 0)
+         close(fd_);
+#endif
+   }
+
+   void start() {
+#ifdef __linux__
+      if(fd_ >= 0) {
+         ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+         ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+      }
+#endif
+   }
+
+   long long stop() {
+      long long res = -1;
+#ifdef __linux__
+      if(fd_ >= 0) {
+         ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+         if(read(fd_, &res, sizeof(res)) != sizeof(res))
+            res = -1;
+      }
+#endif
+      return res;
+   }
+
+private:
+   int fd_;
+};
+
 std::vector<std::string> generateTestKeys(int n, int min_len = 1, int max_len = 16)
 {
 	std::default_random_engine generator;
@@ -265,6 +325,53 @@ void performance_test(std::map<std::string, std::pair<int, double> >& wins, int
    });
 }
 
+// build time and lookup time of exact against sampled column selection
+void build_perf_test(int n, int tries = 10000000) {
+   auto keys = generateTestKeys(n, 4, 16);
+   std::map<std::string, int> data;
+   REP(i, n) 
+      data[keys[i]] = i+1;
+
+   performance_timer mt;
+   static_radix_map<std::string, int> smap_exact(data);
+   double exact_time = mt.reset();
+   static_radix_map<std::string, int> smap_sampled(data, build_options().sample());
+   double sampled_time = mt.reset();
+
+   std::cout 
+      << std::setw(10) << std::left << n << " keys\n" 
+      << "exact   build time:" << round(exact_time, 2) << " size:" << smap_exact.used_mem() << std::endl
+      << "sampled build time:" << round(sampled_time, 2) << " size:" << smap_sampled.used_mem() << std::endl;
+   map_perf_test(smap_exact, keys, tries, "exact columns");
+   map_perf_test(smap_sampled, keys, tries, "sampled columns");
+   std::cout << "\n\n";
+}
+
+// lookup time and dTLB misses of the default allocator against huge pages
+void huge_page_test(int n, int tries = 10000000) {
+   auto keys = generateTestKeys(n, 4, 16);
+   std::map<std::string, int> data;
+   REP(i, n) 
+      data[keys[i]] = i+1;
+
+   static_radix_map<std::string, int> smap(data);
+   static_radix_map<std::string, int, false, aos_layout, huge_page_allocator<char> > hmap(data);
+
+   std::cout << std::setw(10) << std::left << n << " keys, size:" << smap.used_mem() << std::endl;
+   tlb_counter tlb;
+   tlb.start();
+   map_perf_test(smap, keys, tries, "std::allocator");
+   long long misses = tlb.stop();
+   tlb.start();
+   map_perf_test(hmap, keys, tries, "huge_page_allocator");
+   long long huge_misses = tlb.stop();
+   if(misses >= 0)
+      std::cout << "dTLB misses std::allocator:" << misses << " huge_page_allocator:" << huge_misses << std::endl;
+   else
+      std::cout << "dTLB misses not available" << std::endl;
+   std::cout << "\n\n";
+}
+
 template<typename MapT, typename key_type>
 double do_test_std(MapT& my_map, std::vector<key_type>& v, int probes, int n) {
    int elements = v.size();
@@ -345,6 +452,36 @@ void test_type_map(int m, int n, int absent = 0) {
    std::cout << "\n" << std::endl;
 }
 
+// Index boost::uint16_t: a node relaid behind slot 65535 must be rejected, not wrapped
+void small_index_test() {
+   // a subtree of depth 2, then 254 nodes of 257 slots, 65541 slots in all
+   std::vector<std::pair<boost::uint32_t, int> > data;
+   data.push_back(std::make_pair(boost::uint32_t(0), 0));
+   data.push_back(std::make_pair(boost::uint32_t(1) << 8, 1));
+   data.push_back(std::make_pair(boost::uint32_t(1) << 16, 2));
+   for(boost::uint32_t g = 1; g < 255; ++g) {
+      data.push_back(std::make_pair(g << 24, int(data.size())));
+      data.push_back(std::make_pair(g << 24 | 255u << 16, int(data.size())));
+   }
+
+   typedef static_radix_map<boost::uint32_t, int, false, aos_layout, std::allocator<char>, boost::uint16_t> small_map;
+   node_order_type orders[] = {depth_first_nodes, breadth_first_nodes, van_emde_boas_nodes};
+   for(auto order : orders) {
+      std::cout << "uint16 index, node order " << order << ": ";
+      try {
+         small_map smap(data.begin(), data.end(), build_options().node_order(order, true));
+         int wrong = 0;
+         for(auto& p : data) 
+            wrong += smap.value(p.first) != p.second;
+         std::cout << wrong << " wrong values" << std::endl;
+      }
+      catch(std::range_error& e) {
+         std::cout << e.what() << std::endl;
+      }
+   }
+   std::cout << "\n\n";
+}
+
 template<typename T, bool query_only_existing_keys>
 void test_type(int absent) {
    const int N = 100000000;
@@ -403,6 +540,10 @@ int main() {
    perf_startup();
    try {
       //test_type<int16_t, false>(0);
+      //build_perf_test(1000000);
+      //build_perf_test(4000000);
+      //huge_page_test(10000000);
+      //small_index_test();
       performance();
       
    }
@@ -46,7 +46,13 @@
 //       which make sense in static context.
 //
 // Comment:
-//       Keys are in same order as feed in. 
+//       Keys are in same order as feed in, unless build_options::tree_order() 
+//       stores them in the order of their leaves. 
+//
+// Diagnostics:
+//       Defining STATIC_RADIX_MAP_LOOKUP_COUNTERS (C++11) makes all lookups count 
+//       levels, hits, misses by cause and terminator slots per thread, summed by 
+//       lookup_counters_total(). Without the macro the counting compiles to nothing.
 //
 // Requirements:
 //       All key-value-pairs needed for initialization
@@ -57,8 +63,11 @@
 // Open questions: 
 //       - the implemented greedy approach may be suboptimal
 //           
-// Libraries: boost 1.41 (shared_ptr, tuple, noncopyable, type_traits, mpl, counting_iterator), 
-//       prior boost versions >= 1.36 should also work             
+// Libraries: boost 1.41 (config, shared_ptr, iterator, type_traits, mpl), prior boost 
+//       versions >= 1.36 should also work. C++03 builds the aos, soa, keyless, 
+//       fingerprint and packed layouts. C++11 adds the move constructors, allocators 
+//       via std::allocator_traits, steady_clock build times and the lookup counters, 
+//       C++17 the string_view based arena layouts and std::pmr allocators.
 //----------------------------------------------------------------------------
 
 
@@ -67,56 +76,149 @@
 
 #define STATIC_RADIX_MAP_HPP
 
+#include <algorithm>
 #include <cstdlib> // for size_t
+#include <iterator>
+#include <ostream>
 #include <stdexcept>
 #include <utility>
 #include <vector>
 
 #include "boost/iterator/counting_iterator.hpp"
+#include "boost/make_shared.hpp"
+#include "boost/ref.hpp"
 #include "boost/shared_ptr.hpp"
+#include "boost/static_assert.hpp"
 
 #include "static_radix_map_node.hpp"
 
 namespace static_map_stuff {
 
-   template<typename Key, typename Mapped, bool queryOnlyExistingKeys = false>
+   // Layout soa_layout keeps keys and mapped values in separate arrays, its 
+   // iterators yield proxies with members first and second.
+   // Layout keyless_layout, for maps querying only existing keys, releases the keys 
+   // after the build. Iterators and find yield the mapped values, the tree is built 
+   // without buckets and shared subtrees because these compare keys.
+   // Layout packed_values_layout interns the distinct mapped values and stores a bit 
+   // packed id per key, operator[] and iterators write through proxies.
+   // Layout string_arena_layout (C++17) keeps std::string mapped values in one char 
+   // array, value() and const lookups return std::string_view. A written value that 
+   // fits the old one's bytes is stored in place, a longer one is appended: this may 
+   // reallocate the array, invalidating all string_views returned before, and the 
+   // replaced bytes stay unused until compact_values().
+   // Layout key_arena_layout (C++17) keeps std::string keys back to back in one char 
+   // array instead of a std::string each, iterators yield them as std::string_view.
+   // Layout fingerprint_layout<F> is keyless too, lookups compare a hash of type F 
+   // instead of the key, absent keys are found with probability 2^-(8*sizeof(F)).
+   // Allocator is rebound for the key values and the arrays of the tree, e.g. 
+   // std::pmr::polymorphic_allocator<char>. Copies select their allocator like std::vector.
+   // Index sets the width of the tree's slots and node headers, boost::uint16_t 
+   // quarters the tree of maps with up to 16383 keys, larger maps throw range_error.
+   // Up to 32 bit Index the keys must be distinguished within their first 65536 bytes.
+   template<typename Key, typename Mapped, bool queryOnlyExistingKeys = false, typename Layout = aos_layout, typename Allocator = std::allocator<char>, typename Index = std::size_t>
    class static_radix_map {
    public:
       typedef Key key_type;
       typedef Mapped mapped_type;
       typedef std::size_t size_type;
-      typedef static_radix_map<Key, Mapped, queryOnlyExistingKeys> map_type;
-      typedef typename  detail::static_radix_map_node<Key, Mapped, queryOnlyExistingKeys> node_type;
-      typedef typename  node_type::value_type value_type;
+      typedef Allocator allocator_type;
+      typedef static_radix_map<Key, Mapped, queryOnlyExistingKeys, Layout, Allocator, Index> map_type;
+      typedef typename  detail::StorageOfT<Key, Mapped, Layout, Allocator>::type storage_type;
+      typedef typename  detail::static_radix_map_node<Key, Mapped, queryOnlyExistingKeys, storage_type, Allocator, Index> node_type;
+      typedef typename  storage_type::value_type value_type;
+      typedef typename  node_type::mapped_reference mapped_reference;
+      typedef typename  node_type::const_mapped_reference const_mapped_reference;
+      typedef typename  node_type::mapped_value mapped_value;
+      typedef typename  detail::MappedVectorOfT<storage_type, Mapped, Allocator>::type mapped_vector;
+      typedef std::vector<std::size_t, typename detail::RebindT<Allocator, std::size_t>::type> position_vector;
+
+      typedef typename storage_type::iterator iterator;
+      typedef typename storage_type::const_iterator const_iterator;
 
-      typedef typename std::vector<value_type>::iterator iterator;
-      typedef typename std::vector<value_type>::const_iterator const_iterator;
+      typedef typename storage_type::reverse_iterator reverse_iterator;
+      typedef typename storage_type::const_reverse_iterator const_reverse_iterator;
 
-      typedef typename std::vector<value_type>::reverse_iterator reverse_iterator;
-      typedef typename std::vector<value_type>::const_reverse_iterator const_reverse_iterator;
+      BOOST_STATIC_ASSERT((queryOnlyExistingKeys || detail::VerifiesKeysT<storage_type>::value));
 
       template<class Map>
-      static_radix_map(const Map& m) {
-         init_map(m.begin(), m.end());
+      static_radix_map(const Map& m, const build_options& options = build_options(), const Allocator& alloc = Allocator()) 
+         : keyValues_(alloc)
+         , insertion_order_(alloc)
+      {
+         init_map(m.begin(), m.end(), options);
       }
 
       template<typename iterator>
-      static_radix_map(iterator start, iterator end) {
-         init_map(start, end);
+      static_radix_map(iterator start, iterator end, const build_options& options = build_options(), const Allocator& alloc = Allocator()) 
+         : keyValues_(alloc)
+         , insertion_order_(alloc)
+      {
+         init_map(start, end, options);
+      }
+
+      // the tree refers to the key values by index, thus the copy gets its own tree
+      static_radix_map(const map_type& other) 
+         : keyValues_(other.keyValues_)
+         , insertion_order_(other.insertion_order_)
+         , build_seconds_(other.build_seconds_)
+         , budget_max_depth_(other.budget_max_depth_)
+      {
+         if(other.nodeTree_ != 0)
+            nodeTree_ = boost::allocate_shared<node_type>(get_allocator(), boost::cref(*other.nodeTree_), boost::ref(keyValues_), get_allocator());
+      }
+
+#ifndef BOOST_NO_RVALUE_REFERENCES
+      // keys and values are moved into the map, e.g. from make_move_iterator or a vector
+      static_radix_map(std::vector<std::pair<Key, Mapped> >&& v, const build_options& options = build_options(), const Allocator& alloc = Allocator()) 
+         : keyValues_(alloc)
+         , insertion_order_(alloc)
+      {
+         init_map(std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()), options);
+         std::vector<std::pair<Key, Mapped> >().swap(v);
+      }
+
+      // the moved from map is empty and has no tree, nothing is allocated
+      static_radix_map(map_type&& other) BOOST_NOEXCEPT
+         : keyValues_(std::move(other.keyValues_))
+         , insertion_order_(std::move(other.insertion_order_))
+         , build_seconds_(other.build_seconds_)
+         , budget_max_depth_(other.budget_max_depth_)
+      {
+         nodeTree_.swap(other.nodeTree_);
+         if(nodeTree_ != 0)
+            nodeTree_->rebind(keyValues_);
+         other.keyValues_.clear();
+         other.insertion_order_.clear();
+         other.build_seconds_ = 0.0;
+         other.budget_max_depth_ = std::size_t(-1);
+      }
+
+      map_type& operator=(map_type&& other) BOOST_NOEXCEPT {
+         if(this != &other) {
+            map_type tmp(std::move(other));
+            this->swap(tmp);
+         }
+         return *this;
       }
+#endif
 
       // returns Mapped() for non existing keys
-      Mapped value(const Key& key) const {
-         return nodeTree_->value(key);
+      mapped_value value(const Key& key) const {
+         return nodeTree_ == 0 ? mapped_value() : nodeTree_->value(key);
       }
 
-      // throws runtime_error for non existing keys
-      Mapped& operator[](const Key& key)  {
+      // throws runtime_error for non existing keys. The reference is a write proxy 
+      // for packed_values_layout.
+      mapped_reference operator[](const Key& key)  {
+         if(nodeTree_ == 0)
+            throw std::runtime_error("static_radix_map::value: key does not exists!");
          return nodeTree_->value_ref(key);
       }
 
-      const Mapped& operator[](const Key& key)  const {
-         return nodeTree_->value_ref(key);
+      const_mapped_reference operator[](const Key& key)  const {
+         if(nodeTree_ == 0)
+            throw std::runtime_error("static_radix_map::value: key does not exists!");
+         return static_cast<const node_type&>(*nodeTree_).value_ref(key);
       }
 
       map_type& operator=(const map_type& other) {
@@ -128,38 +230,38 @@ namespace static_map_stuff {
       }
 
       template<bool query_only_existing_keys>
-      bool operator==(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator==(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ == other.keyValues_; 
       }
 
       template<bool query_only_existing_keys>
-      bool operator!=(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator!=(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ != other.keyValues_; 
       }
 
       template<bool query_only_existing_keys>
-      bool operator<(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator<(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ < other.keyValues_; 
       }
 
       template<bool query_only_existing_keys>
-      bool operator>(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator>(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ > other.keyValues_; 
       }
 
       template<bool query_only_existing_keys>
-      bool operator<=(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator<=(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ <= other.keyValues_; 
       }
 
       template<bool query_only_existing_keys>
-      bool operator>=(const static_radix_map<Key, Mapped, query_only_existing_keys>& other) const { 
+      bool operator>=(const static_radix_map<Key, Mapped, query_only_existing_keys, Layout, Allocator, Index>& other) const { 
          return keyValues_ >= other.keyValues_; 
       }
 
       // count returns 1 for existing keys otherwise 0
       std::size_t count(const Key& key) const {
-         return nodeTree_->count(key);
+         return nodeTree_ == 0 ? 0 : nodeTree_->count(key);
       } 
 
       // iterators are realized via delegation
@@ -196,25 +298,54 @@ namespace static_map_stuff {
       }
 
       const_iterator find( const key_type& key ) const {	
-         const value_type* p = nodeTree_->tuple(key);
-         if(p != 0)
-            return begin() + (p-&keyValues_[0]);
+         std::size_t i = position(key);
+         if(i != node_type::NO_TUPLE)
+            return begin() + i;
          else
             return end();
       }
 
       iterator find( const key_type& key ) {
-         value_type* p = nodeTree_->tuple(key);
-         if(p != 0)
-            return begin() + (p-&keyValues_[0]);
+         std::size_t i = position(key);
+         if(i != node_type::NO_TUPLE)
+            return begin() + i;
          else
             return end();
       }
 
+      // soa_layout, keyless layouts and key_arena_layout: the packed mapped values 
+      // in iteration order
+      mapped_vector& mapped_values() {
+         return keyValues_.values();
+      }
+
+      const mapped_vector& mapped_values() const {
+         return keyValues_.values();
+      }
+
+      // string_arena_layout only: rewrites the value array without the bytes of 
+      // replaced values, invalidating all string_views of the values
+      void compact_values() {
+         keyValues_.compact();
+      }
+
+      // positions of the entries in feed order for maps built with tree_order(), 
+      // *(begin()+insertion_order()[i]) is the i-th entry fed in. Empty otherwise.
+      const position_vector& insertion_order() const {
+         return insertion_order_;
+      }
+
       void swap(map_type& other) {
          // never throws an exception
          std::swap(keyValues_, other.keyValues_);
+         insertion_order_.swap(other.insertion_order_);
+         std::swap(build_seconds_, other.build_seconds_);
+         std::swap(budget_max_depth_, other.budget_max_depth_);
          std::swap(nodeTree_, other.nodeTree_);
+         if(nodeTree_ != 0)
+            nodeTree_->rebind(keyValues_);
+         if(other.nodeTree_ != 0)
+            other.nodeTree_->rebind(other.keyValues_);
       }
 
       bool empty() const {
@@ -233,7 +364,10 @@ namespace static_map_stuff {
 
       void clear() {
          keyValues_.clear();
-         nodeTree_.clear();
+         insertion_order_.clear();
+         build_seconds_ = 0.0;
+         budget_max_depth_ = std::size_t(-1);
+         nodeTree_ = make_tree(std::vector<std::size_t>(), build_options());
       }
 
       size_type size() const {
@@ -244,27 +378,170 @@ namespace static_map_stuff {
          return keyValues_.max_size();
       }
 
-      // used memory in bytes 
+      allocator_type get_allocator() const {
+         return allocator_type(keyValues_.get_allocator());
+      }
+
+      // used memory in bytes of the index: the map object, the tree, the 
+      // insertion order and the key arena of key_arena_layout, without other key values
       std::size_t used_mem() const {
-         return sizeof(*this)+(nodeTree_== 0 ? 0 : nodeTree_->used_mem());
+         return 
+            sizeof(*this)
+            + insertion_order_.capacity()*sizeof(std::size_t)
+            + detail::index_mem(keyValues_)
+            + (nodeTree_== 0 ? 0 : nodeTree_->used_mem());
+      }
+
+      // depth histogram, fanouts, slot fill and columns of the tree and the build time.
+      // Visits every node, meant for diagnostics after the build.
+      tree_stats stats() const {
+         if(nodeTree_ == 0)
+            return empty_map().stats();
+         tree_stats res = nodeTree_->stats();
+         res.build_seconds = build_seconds_;
+         res.budget_max_depth = budget_max_depth_;
+         return res;
+      }
+
+      // the nodes, bytes and slots a lookup of the key passes and how its leaf
+      // compares. position is the entry's offset from begin() if found().
+      lookup_trace explain(const Key& key) const {
+         return nodeTree_ == 0 ? empty_map().explain(key) : nodeTree_->explain(key);
+      }
+
+      // the tree as Graphviz dot or JSON, for offline inspection of the layout
+      void write_dot(std::ostream& os) const {
+         if(nodeTree_ == 0)
+            empty_map().write_dot(os);
+         else
+            nodeTree_->write_dot(os);
+      }
+
+      void write_json(std::ostream& os) const {
+         if(nodeTree_ == 0)
+            empty_map().write_json(os);
+         else
+            nodeTree_->write_json(os);
+      }
+
+      // all memory of the map by part, including the key values and the heap blocks 
+      // of string keys and values. Visits each entry only for string keys or values.
+      memory_usage memory_breakdown() const {
+         memory_usage usage;
+         usage.index = sizeof(*this);
+         detail::add_vector(insertion_order_, usage.index, usage.heap_blocks);
+         detail::storage_mem(keyValues_, usage);
+         if(nodeTree_ != 0) {
+            nodeTree_->add_mem(usage);
+            ++usage.heap_blocks;
+         }
+         // a malloc header and on average half an alignment unit per block
+         usage.allocator_overhead = usage.heap_blocks*2*sizeof(void*);
+         return usage;
       }
 
    private:
-      std::vector<value_type> keyValues_;
-      boost::shared_ptr<node_type> nodeTree_;
+      storage_type keyValues_;
+      position_vector insertion_order_;
+      double build_seconds_;
+      std::size_t budget_max_depth_;   // depth bound the memory budget forced, -1 if none
+      boost::shared_ptr<node_type> nodeTree_;   // 0 after the map was moved from
+
+      // position of the key's entry, NO_TUPLE if it is missing or the map was moved from
+      std::size_t position(const Key& key) const {
+         return nodeTree_ == 0 ? std::size_t(node_type::NO_TUPLE) : nodeTree_->tuple(key);
+      }
+
+      // stands in for the tree of a moved from map in the diagnostics
+      map_type empty_map() const {
+         return map_type(std::vector<std::pair<Key, Mapped> >(), build_options(), get_allocator());
+      }
 
       template<typename iterator>
-      void init_map(iterator start, iterator end) {
+      void init_map(iterator start, iterator end, const build_options& options) {
          // pre-process data
+         double start_time = detail::clock_seconds();
          std::size_t sz = std::distance(start, end);
          keyValues_.reserve(sz);
          for(iterator iter=start; iter != end; ++iter) {
-            keyValues_.push_back(value_type(iter->first, iter->second));
+#ifndef BOOST_NO_RVALUE_REFERENCES
+            // rvalue pairs of move iterators are moved member wise
+            typedef typename std::iterator_traits<iterator>::reference reference;
+            reference p = *iter;
+            keyValues_.emplace_back(std::forward<reference>(p).first, std::forward<reference>(p).second);
+#else
+            keyValues_.push_back(std::pair<Key, Mapped>(iter->first, iter->second));
+#endif
          }
 
          // initial selection are all keys for root node 
          std::vector<std::size_t> selection(::boost::counting_iterator<std::size_t>(0), ::boost::counting_iterator<std::size_t>(sz));
-         nodeTree_.reset(new node_type(keyValues_, selection));
+         if(options.tree_order_)
+            tree_order_entries(selection, options);
+         detail::shrink_entries(keyValues_);
+         nodeTree_ = make_tree(selection, options);
+         budget_max_depth_ = std::size_t(-1);
+         if(options.mem_budget_ > 0 && used_mem() > options.mem_budget_)
+            fit_mem_budget(selection, options);
+         detail::drop_keys(keyValues_);
+         build_seconds_ = detail::clock_seconds()-start_time;
+      }
+
+      boost::shared_ptr<node_type> make_tree(const std::vector<std::size_t>& selection, const build_options& options) {
+         build_options tree_options(options);
+         if(!detail::KeepsKeysT<storage_type>::value) {
+            // lookups must not compare keys
+            tree_options.max_depth_ = std::size_t(-1);
+            tree_options.share_subtrees_ = false;
+         }
+         return boost::allocate_shared<node_type>(get_allocator(), boost::ref(keyValues_), boost::cref(selection), boost::cref(tree_options), get_allocator());
+      }
+
+      // Stores the key values in the memory order of the leaves of a first tree. 
+      // Its leaves are not shared, thus every tuple has its own leaf.
+      void tree_order_entries(const std::vector<std::size_t>& selection, const build_options& options) {
+         build_options plain(options);
+         plain.root_table_bytes_ = 0;
+         plain.share_subtrees_ = false;
+         std::vector<std::size_t> order = make_tree(selection, plain)->leaf_order();
+
+         detail::permute_entries(keyValues_, order);
+         insertion_order_.resize(order.size());
+         for(std::size_t i = 0; i < order.size(); ++i)
+            insertion_order_[order[i]] = i;
+      }
+
+      // rebuild with increasingly compact settings until the budget is met
+      void fit_mem_budget(const std::vector<std::size_t>& selection, const build_options& options) {
+         std::vector<build_options> tries;
+         build_options compact(options);
+         compact.root_table_bytes_ = 0;
+         compact.fixed_depth_ = false;
+         compact.share_subtrees_ = true;
+         tries.push_back(compact);
+
+         const double fills[] = { 0.25, 0.5, 0.75, 1.0 };
+         for(std::size_t i = 0; i < sizeof(fills)/sizeof(fills[0]); ++i) {
+            compact.min_fill_ = std::max(options.min_fill_, fills[i]);
+            tries.push_back(compact);
+         }
+
+         compact.min_fill_ = options.min_fill_;
+         // depth bounds need buckets, which compare keys. Depth 0 would put all keys 
+         // in one bucket, thus the bound stops at 1.
+         std::size_t max_depth = detail::KeepsKeysT<storage_type>::value ? std::min(nodeTree_->max_path_length(), options.max_depth_) : 0;
+         for(std::size_t depth = max_depth; depth-- > 1;) {
+            compact.max_depth_ = depth;
+            tries.push_back(compact);
+         }
+
+         for(std::size_t i = 0; i < tries.size() && used_mem() > options.mem_budget_; ++i) {
+            boost::shared_ptr<node_type> candidate = make_tree(selection, tries[i]);
+            if(candidate->used_mem() < nodeTree_->used_mem()) {
+               nodeTree_ = candidate;
+               budget_max_depth_ = tries[i].max_depth_ < options.max_depth_ ? tries[i].max_depth_ : std::size_t(-1);
+            }
+         }
       }
 
    };
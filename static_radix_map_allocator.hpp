@@ -0,0 +1,164 @@
+//----------------------------------------------------------------------------
+//
+// Copyright (c) 2010 Martin Richardt
+//
+//      email: martin.richardt@web.de
+//
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies, substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//----------------------------------------------------------------------------
+//
+// File:    static_radix_map_allocator.hpp, header only template implementation
+// Purpose:
+//       huge page allocator for the Allocator parameter of static_radix_map.
+//       Large maps spread their slots over many 4K pages, thus most lookups
+//       miss the dTLB. Arrays of at least one huge page are placed on 2MB pages:
+//       explicit huge pages (MAP_HUGETLB) if the system has reserved some,
+//       otherwise 2MB aligned memory advised as transparent huge pages
+//       (MADV_HUGEPAGE). Smaller arrays and non Linux systems use operator new.
+//
+// Usage:
+//       static_radix_map<Key, Mapped, false, aos_layout, huge_page_allocator<char> >
+//----------------------------------------------------------------------------
+
+
+
+#ifndef STATIC_RADIX_MAP_ALLOCATOR_HPP
+
+#define STATIC_RADIX_MAP_ALLOCATOR_HPP
+
+#include <cstdlib> // for size_t
+#include <cstddef>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace static_map_stuff {
+
+   template<class T>
+   class huge_page_allocator {
+   public:
+      static const std::size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef std::size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+
+      template<class U>
+      struct rebind {
+         typedef huge_page_allocator<U> other;
+      };
+
+      huge_page_allocator()
+      {}
+
+      template<class U>
+      huge_page_allocator(const huge_page_allocator<U>&)
+      {}
+
+      pointer allocate(size_type n, const void* = 0) {
+         std::size_t bytes = n*sizeof(T);
+#ifdef __linux__
+         if(bytes >= HUGE_PAGE_SIZE)
+            return static_cast<pointer>(map_pages(page_size(bytes)));
+#endif
+         return static_cast<pointer>(::operator new(bytes));
+      }
+
+      void deallocate(pointer p, size_type n) {
+         std::size_t bytes = n*sizeof(T);
+#ifdef __linux__
+         if(bytes >= HUGE_PAGE_SIZE) {
+            munmap(p, page_size(bytes));
+            return;
+         }
+#endif
+         ::operator delete(p);
+      }
+
+      size_type max_size() const {
+         return std::size_t(-1)/sizeof(T);
+      }
+
+      pointer address(reference x) const {
+         return &x;
+      }
+
+      const_pointer address(const_reference x) const {
+         return &x;
+      }
+
+      void construct(pointer p, const T& value) {
+         new(static_cast<void*>(p)) T(value);
+      }
+
+      void destroy(pointer p) {
+         p->~T();
+      }
+
+   private:
+      static std::size_t page_size(std::size_t bytes) {
+         return (bytes+HUGE_PAGE_SIZE-1)/HUGE_PAGE_SIZE*HUGE_PAGE_SIZE;
+      }
+
+#ifdef __linux__
+      static void* map_pages(std::size_t bytes) {
+#ifdef MAP_HUGETLB
+         void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+         if(p != MAP_FAILED)
+            return p;
+#endif
+         // transparent huge pages need 2MB aligned ranges, the slack is unmapped
+         std::size_t size = bytes+HUGE_PAGE_SIZE;
+         void* raw = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+         if(raw == MAP_FAILED)
+            throw std::bad_alloc();
+
+         char* first = static_cast<char*>(raw);
+         char* aligned = first + (HUGE_PAGE_SIZE - reinterpret_cast<std::size_t>(first)%HUGE_PAGE_SIZE)%HUGE_PAGE_SIZE;
+         if(aligned != first)
+            munmap(first, aligned-first);
+         if(first+size != aligned+bytes)
+            munmap(aligned+bytes, first+size-(aligned+bytes));
+#ifdef MADV_HUGEPAGE
+         madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+         return aligned;
+      }
+#endif
+   };
+
+   template<class T, class U>
+   bool operator==(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+      return true;
+   }
+
+   template<class T, class U>
+   bool operator!=(const huge_page_allocator<T>&, const huge_page_allocator<U>&) {
+      return false;
+   }
+
+} // namespace static_map_stuff
+
+#endif
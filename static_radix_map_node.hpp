@@ -30,23 +30,418 @@
 #define STATIC_MAP_RADIX_NODE_HPP
 
 #include <cstdlib> // for size_t
+#include <algorithm>
 #include <cstring> // for strlen
-#include <set>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <boost/config.hpp>
+
+// C++11 and C++17 library parts follow the language level, older Boost.Config releases
+// do not define the BOOST_NO_CXX11_.. and BOOST_NO_CXX17_.. macros
+#if defined(_MSVC_LANG)
+#define STATIC_RADIX_MAP_CPLUSPLUS _MSVC_LANG
+#else
+#define STATIC_RADIX_MAP_CPLUSPLUS __cplusplus
+#endif
+#if STATIC_RADIX_MAP_CPLUSPLUS >= 201103L && !defined(BOOST_NO_CXX11_HDR_CHRONO)
+#define STATIC_RADIX_MAP_HAS_CHRONO
+#include <chrono>
+#endif
+#if STATIC_RADIX_MAP_CPLUSPLUS >= 201103L && !defined(BOOST_NO_CXX11_ALLOCATOR)
+#define STATIC_RADIX_MAP_HAS_ALLOCATOR_TRAITS
+#endif
+#if STATIC_RADIX_MAP_CPLUSPLUS >= 201703L && !defined(BOOST_NO_CXX17_HDR_STRING_VIEW)
+#define STATIC_RADIX_MAP_HAS_STRING_VIEW
+#include <string_view>
+#endif
+#ifdef STATIC_RADIX_MAP_LOOKUP_COUNTERS
+#if STATIC_RADIX_MAP_CPLUSPLUS < 201103L || defined(BOOST_NO_CXX11_THREAD_LOCAL) || defined(BOOST_NO_CXX11_HDR_ATOMIC) || defined(BOOST_NO_CXX11_HDR_MUTEX)
+#error "STATIC_RADIX_MAP_LOOKUP_COUNTERS needs thread_local, <atomic> and <mutex>"
+#endif
+#include <atomic>
+#include <mutex>
+#endif
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/reverse_iterator.hpp>
 #include <boost/mpl/end.hpp>
 #include <boost/mpl/find.hpp>
+#include <boost/mpl/if.hpp>
 #include <boost/mpl/vector.hpp>
+#include "boost/cstdint.hpp"
 #include "boost/noncopyable.hpp"
 #include "boost/shared_ptr.hpp"
+#include "boost/static_assert.hpp"
 #include "boost/type_traits.hpp"
 #include "boost/tuple/tuple.hpp"
 
 
 namespace static_map_stuff {
 
+   // memory order of the nodes of a tree
+   enum node_order_type {
+      depth_first_nodes,     // build order
+      breadth_first_nodes,   // level by level, the top levels share few cache lines
+      van_emde_boas_nodes    // recursively the top half levels, then each subtree below
+   };
+
+   // Build time tuning knobs. The defaults produce the classic greedy tree.
+   struct build_options {
+      build_options()
+         : root_table_bytes_(0)
+         , fixed_depth_(false)
+         , max_depth_(std::size_t(-1))
+         , mem_budget_(0)
+         , min_fill_(0.0)
+         , sample_threshold_(0)
+         , sample_size_(0)
+         , inline_keys_(false)
+         , share_subtrees_(false)
+         , node_order_(depth_first_nodes)
+         , weighted_order_(false)
+         , tree_order_(false)
+      {}
+
+      // collapse the two top levels into one table directly indexed by the bytes of 
+      // two columns. The table is only built if it needs at most max_bytes of memory.
+      build_options& root_table(std::size_t max_bytes = 65536) {
+         root_table_bytes_ = max_bytes;
+         return *this;
+      }
+
+      // maps querying only existing keys: pad all leaves to the same depth, so a 
+      // lookup is a fixed sequence of loads. Takes precedence over the root table.
+      build_options& fixed_depth(bool on = true) {
+         fixed_depth_ = on;
+         return *this;
+      }
+
+      // upper bound of max_path_length(). Keys which would be placed deeper are 
+      // stored in sorted buckets at the bound and found by a binary search.
+      build_options& max_depth(std::size_t depth) {
+         max_depth_ = depth;
+         return *this;
+      }
+
+      // memory budget in bytes of used_mem(). If the default build exceeds the 
+      // budget the map is rebuilt without root table and padding and with 
+      // shared subtrees, then with denser columns, then with decreasing depth bounds 
+      // down to 1, until the budget is met. stats().budget_max_depth tells a depth 
+      // bound forced by the budget. Otherwise the smallest tree is kept, check 
+      // used_mem() against the budget.
+      build_options& mem_budget(std::size_t bytes) {
+         mem_budget_ = bytes;
+         return *this;
+      }
+
+      // columns whose used slots fill less than this fraction of their slot interval
+      // are only chosen if no other column splits the keys
+      build_options& min_fill(double fill) {
+         min_fill_ = fill;
+         return *this;
+      }
+
+      // nodes with more than threshold keys choose their column from a random 
+      // sample of sample_size keys instead of counting all keys
+      build_options& sample(std::size_t threshold = 65536, std::size_t sample_size = 4096) {
+         sample_threshold_ = threshold;
+         sample_size_ = sample_size;
+         return *this;
+      }
+
+      // fixed length keys of up to 5 bytes (64 bit): leaf slots keep a copy of their key, 
+      // lookups of absent keys are rejected in the slot without loading the tuple
+      build_options& inline_keys(bool on = true) {
+         inline_keys_ = on;
+         return *this;
+      }
+
+      // merge subtrees of equal shape, e.g. below the root slots of cross product 
+      // key sets. Leaves are relative to offsets carried by the links. Not combined 
+      // with fixed_depth, root_table and inline_keys.
+      build_options& share_subtrees(bool on = true) {
+         share_subtrees_ = on;
+         return *this;
+      }
+
+      // lays out the nodes in the given order after the build. Weighted orders
+      // place the children with more keys first, assuming equally frequent keys.
+      build_options& node_order(node_order_type order, bool weighted = false) {
+         node_order_ = order;
+         weighted_order_ = weighted;
+         return *this;
+      }
+
+      // stores the key values in the memory order of their leaves instead of the feed 
+      // order, the map's insertion_order() maps the feed order to positions. 
+      // The tree is built twice.
+      build_options& tree_order(bool on = true) {
+         tree_order_ = on;
+         return *this;
+      }
+
+      std::size_t root_table_bytes_;
+      bool fixed_depth_;
+      std::size_t max_depth_;
+      std::size_t mem_budget_;
+      double min_fill_;
+      std::size_t sample_threshold_;
+      std::size_t sample_size_;
+      bool inline_keys_;
+      bool share_subtrees_;
+      node_order_type node_order_;
+      bool weighted_order_;
+      bool tree_order_;
+   };
+
+   // bytes of a map by part, see static_radix_map::memory_breakdown()
+   struct memory_usage {
+      memory_usage()
+         : node_headers(0)
+         , slots(0)
+         , buckets(0)
+         , keys(0)
+         , values(0)
+         , index(0)
+         , heap_blocks(0)
+         , allocator_overhead(0)
+      {}
+
+      std::size_t total() const {
+         return node_headers + slots + buckets + keys + values + index + allocator_overhead;
+      }
+
+      std::size_t node_headers;        // column and slot interval of each node
+      std::size_t slots;               // slot arrays and the root table
+      std::size_t buckets;             // leaf buckets and their entry positions
+      std::size_t keys;                // keys with their heap strings, fingerprints, key arena
+      std::size_t values;              // mapped values with their heap strings, packed ids, string arena
+      std::size_t index;               // map and tree objects, insertion order
+      std::size_t heap_blocks;         // number of heap allocations
+      std::size_t allocator_overhead;  // estimated bookkeeping of the heap allocations
+   };
+
+   // shape of a built tree, see static_radix_map::stats(). Depths count the links 
+   // followed from the root node like max_path_length().
+   struct tree_stats {
+      tree_stats()
+         : keys(0)
+         , max_depth(0)
+         , average_depth(0.0)
+         , nodes(0)
+         , slots(0)
+         , used_slots(0)
+         , buckets(0)
+         , max_bucket_size(0)
+         , build_seconds(0.0)
+         , budget_max_depth(std::size_t(-1))
+      {}
+
+      // used slots per slot of all slot arrays
+      double fill_ratio() const {
+         return slots == 0 ? 0.0 : (used_slots*1.0)/slots;
+      }
+
+      std::size_t keys;
+      std::size_t max_depth;
+      double average_depth;
+      std::vector<std::size_t> keys_by_depth;     // [depth] number of keys
+      std::size_t nodes;
+      std::vector<std::size_t> nodes_by_fanout;   // [used slots] number of nodes
+      std::vector<std::size_t> nodes_by_column;   // [column] number of nodes splitting by it
+      std::size_t slots;
+      std::size_t used_slots;                     // links and leaves with keys
+      std::size_t buckets;
+      std::size_t max_bucket_size;
+      double build_seconds;                       // wall clock, processor time before C++11
+      std::size_t budget_max_depth;               // depth bound set by mem_budget(), keys below are bucketed, -1 if none
+   };
+
+   // how a lookup leaves a node
+   enum lookup_slot_type {
+      byte_slot,         // the slot of the key byte at the node's column
+      terminator_slot,   // the key ends before the column
+      empty_slot         // the key byte is out of the node's byte interval
+   };
+
+   // outcome at the leaf reached by a lookup
+   enum lookup_result_type {
+      key_found,         // an entry's key (or fingerprint) equals the key
+      key_mismatch,      // the keys of the leaf differ from the key
+      empty_leaf,        // the slot holds no entry
+      key_unverified     // keyless storage returns the entry of the leaf unchecked
+   };
+
+   // one node on the path of a lookup
+   struct lookup_step {
+      std::size_t node;            // position of the node header
+      std::size_t column;          // key byte tested by the node
+      int byte;                    // value of the key byte, -1 if the key is shorter
+      std::size_t min_slot;        // byte interval of the node's slots
+      std::size_t max_slot;
+      lookup_slot_type slot;
+   };
+
+   // path and outcome of a lookup, see static_radix_map::explain()
+   struct lookup_trace {
+      lookup_trace()
+         : result(empty_leaf)
+         , bucket_size(0)
+         , position(0)
+      {}
+
+      bool found() const {
+         return result == key_found || result == key_unverified;
+      }
+
+      std::vector<lookup_step> path;
+      lookup_result_type result;
+      std::size_t bucket_size;     // keys compared in a bucket leaf, 0 for single entries
+      std::size_t position;        // of the entry in the map if found(), size() otherwise
+   };
+
+#ifdef STATIC_RADIX_MAP_LOOKUP_COUNTERS
+   // lookup counters of all threads, see lookup_counters_total()
+   struct lookup_counters {
+      lookup_counters()
+         : lookups(0)
+         , levels(0)
+         , hits(0)
+         , range_misses(0)
+         , empty_misses(0)
+         , compare_misses(0)
+         , terminator_slots(0)
+      {}
+
+      std::size_t misses() const {
+         return range_misses + empty_misses + compare_misses;
+      }
+
+      std::size_t lookups;
+      std::size_t levels;             // slot arrays loaded, the root table counts once
+      std::size_t hits;
+      std::size_t range_misses;       // key byte out of a node's byte interval
+      std::size_t empty_misses;       // leaf slot without entry
+      std::size_t compare_misses;     // keys or fingerprints of the leaf differ
+      std::size_t terminator_slots;   // keys ending before the column of a node
+   };
+
+   namespace detail {
+
+      enum LookupCounterT {
+         LOOKUP_LOOKUPS, 
+         LOOKUP_LEVELS, 
+         LOOKUP_HITS, 
+         LOOKUP_RANGE_MISSES, 
+         LOOKUP_EMPTY_MISSES, 
+         LOOKUP_COMPARE_MISSES, 
+         LOOKUP_TERMINATOR_SLOTS, 
+         LOOKUP_COUNTER_COUNT
+      };
+
+      // Each thread counts into its own block, written by the thread only. Blocks of 
+      // finished threads are added to retired_.
+      struct LookupCountersT {
+         LookupCountersT();
+         ~LookupCountersT();
+
+         std::atomic<std::size_t> counts_[LOOKUP_COUNTER_COUNT];
+      };
+
+      struct LookupRegistryT {
+         std::mutex mutex_;
+         std::vector<LookupCountersT*> threads_;
+         std::size_t retired_[LOOKUP_COUNTER_COUNT];
+      };
+
+      inline LookupRegistryT& lookup_registry() {
+         static LookupRegistryT registry;
+         return registry;
+      }
+
+      inline LookupCountersT::LookupCountersT() {
+         for(std::size_t i = 0; i < LOOKUP_COUNTER_COUNT; ++i)
+            counts_[i].store(0, std::memory_order_relaxed);
+         LookupRegistryT& registry = lookup_registry();
+         std::lock_guard<std::mutex> lock(registry.mutex_);
+         registry.threads_.push_back(this);
+      }
+
+      inline LookupCountersT::~LookupCountersT() {
+         LookupRegistryT& registry = lookup_registry();
+         std::lock_guard<std::mutex> lock(registry.mutex_);
+         for(std::size_t i = 0; i < LOOKUP_COUNTER_COUNT; ++i)
+            registry.retired_[i] += counts_[i].load(std::memory_order_relaxed);
+         registry.threads_.erase(std::find(registry.threads_.begin(), registry.threads_.end(), this));
+      }
+
+      // a single writer needs no atomic read-modify-write
+      inline void count_lookup(LookupCounterT counter, std::size_t n = 1) {
+         static thread_local LookupCountersT counters;
+         std::atomic<std::size_t>& count = counters.counts_[counter];
+         count.store(count.load(std::memory_order_relaxed)+n, std::memory_order_relaxed);
+      }
+
+   } // namespace detail
+
+   // sum of the counters of all threads since the last reset
+   inline lookup_counters lookup_counters_total() {
+      detail::LookupRegistryT& registry = detail::lookup_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex_);
+      std::size_t sums[detail::LOOKUP_COUNTER_COUNT];
+      for(std::size_t i = 0; i < detail::LOOKUP_COUNTER_COUNT; ++i) {
+         sums[i] = registry.retired_[i];
+         for(std::size_t t = 0; t < registry.threads_.size(); ++t)
+            sums[i] += registry.threads_[t]->counts_[i].load(std::memory_order_relaxed);
+      }
+      lookup_counters res;
+      res.lookups = sums[detail::LOOKUP_LOOKUPS];
+      res.levels = sums[detail::LOOKUP_LEVELS];
+      res.hits = sums[detail::LOOKUP_HITS];
+      res.range_misses = sums[detail::LOOKUP_RANGE_MISSES];
+      res.empty_misses = sums[detail::LOOKUP_EMPTY_MISSES];
+      res.compare_misses = sums[detail::LOOKUP_COMPARE_MISSES];
+      res.terminator_slots = sums[detail::LOOKUP_TERMINATOR_SLOTS];
+      return res;
+   }
+
+   // counts racing with the reset may survive it
+   inline void reset_lookup_counters() {
+      detail::LookupRegistryT& registry = detail::lookup_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex_);
+      for(std::size_t i = 0; i < detail::LOOKUP_COUNTER_COUNT; ++i) {
+         registry.retired_[i] = 0;
+         for(std::size_t t = 0; t < registry.threads_.size(); ++t)
+            registry.threads_[t]->counts_[i].store(0, std::memory_order_relaxed);
+      }
+   }
+
+#define STATIC_RADIX_MAP_COUNT(counter, n) ::static_map_stuff::detail::count_lookup(::static_map_stuff::detail::LOOKUP_##counter, n)
+#else
+#define STATIC_RADIX_MAP_COUNT(counter, n) ((void)0)
+#endif
+
+   // storage layouts of the key values
+   struct aos_layout {};   // one array of key value pairs
+   struct soa_layout {};   // keys and mapped values in separate arrays
+   struct keyless_layout {};   // maps querying only existing keys: mapped values only
+   struct packed_values_layout {};   // keys and bit packed ids of the distinct mapped values
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+   struct string_arena_layout {};   // std::string mapped values in one char arena, read as std::string_view
+   struct key_arena_layout {};   // std::string keys in one char arena, iterators yield them as std::string_view
+#endif
+
+   // mapped values and a hash of each key of type boost::uint8_t, uint16_t or uint32_t.
+   // An absent key reaching a leaf is accepted with probability 2^-(8*sizeof(Fingerprint)).
+   template<class Fingerprint>
+   struct fingerprint_layout {};
+
    namespace detail {
 
       // Map data abstraction. 
@@ -62,6 +457,14 @@ namespace static_map_stuff {
             : std::pair<Key, Mapped>(p)
          {}
 
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         // moves rvalue keys and values into the map
+         template<class K, class M>
+         MapDataT(K&& key, M&& value)
+            : std::pair<Key, Mapped>(std::forward<K>(key), std::forward<M>(value))
+         {}
+#endif
+
          std::size_t size() const {
             return sizeof(Key);
          }
@@ -94,6 +497,13 @@ namespace static_map_stuff {
             : std::pair<std::string, Mapped>(p)
          {}
 
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         template<class K, class M>
+         MapDataT(K&& key, M&& value)
+            : std::pair<std::string, Mapped>(std::forward<K>(key), std::forward<M>(value))
+         {}
+#endif
+
          std::size_t size() const {
             return std::pair<std::string, Mapped>::first.size();
          }
@@ -130,6 +540,14 @@ namespace static_map_stuff {
             , size_(std::strlen(p.first))
          {}
 
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         template<class K, class M>
+         MapDataT(K&& key, M&& value)
+            : std::pair<const char*, Mapped>(std::forward<K>(key), std::forward<M>(value))
+            , size_(std::strlen(std::pair<const char*, Mapped>::first))
+         {}
+#endif
+
          std::size_t size() const {
             return size_;
          }
@@ -186,370 +604,2984 @@ namespace static_map_stuff {
          return std::strlen(s);
       }
 
-      // --------------------------------------------------------------------------------------------
+      // allocator for T from the allocator of the map
+      template<class Allocator, class T>
+      struct RebindT {
+#ifdef STATIC_RADIX_MAP_HAS_ALLOCATOR_TRAITS
+         typedef typename std::allocator_traits<Allocator>::template rebind_alloc<T> type;
+#else
+         typedef typename Allocator::template rebind<T>::other type;
+#endif
+      };
 
-      template<typename Key, typename Mapped, bool queryOnlyExistingKeys = false>
-      class static_radix_map_node : boost::noncopyable  
-      {
-      public:
-         static const std::size_t MAX_SLOTS = 257;
-         typedef unsigned char byte_t;
-         typedef MapDataT<Key, Mapped> value_type;
+      // ----------------------------
+      // Structure of arrays storage: keys and mapped values in separate arrays, 
+      // iterators yield proxies behaving like std::pair<const Key, Mapped>&
 
-         typedef std::vector<value_type>	TupleVectorT;
-         typedef typename boost::remove_const<Key>::type	KeyBase;
-         typedef static_radix_map_node<Key, Mapped, queryOnlyExistingKeys> node_t;
+      template<class Key>
+      struct MapKeyT {
+         MapKeyT(const Key& key)
+            : key_(key)
+         {}
 
-         static_radix_map_node(TupleVectorT& data, const std::vector<std::size_t>& nodeIndexes) 
-            : ndx_(0)
-            , nodes_(0)
-            , data_(data)     
-            , min_slot_(255)
-            , max_slot_(0)
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         MapKeyT(Key&& key)
+            : key_(std::move(key))
+         {}
+#endif
 
-         {
-            if(!nodeIndexes.empty())
-               initialize(data, nodeIndexes);
+         std::size_t size() const {
+            return sizeof(Key);
          }
 
-         ~static_radix_map_node() {
-            clear();
+         operator const char*() const {
+            return reinterpret_cast<const char*>(&key_);
          }
 
-         void clear() {
-            for(std::size_t i = 0, i_end = slot_size(min_slot_, max_slot_); i < i_end; ++i) 
-               delete nodes_[i];
-            delete[] nodes_;
-            ndx_ = MAX_SLOTS;
-         }
-
-         void initialize(TupleVectorT& data, const std::vector<std::size_t>& nodeIndexes) {
-            ndx_ = this->calc_best_index(nodeIndexes);
-            std::vector<std::vector<std::size_t> > slots;
-            slots.resize(MAX_SLOTS);
-            std::vector<std::size_t> next_stage;
-
-            for(std::size_t i = 0, i_end = nodeIndexes.size(); i < i_end; ++i) {
-               int ii = nodeIndexes[i];
-               if(node_t::key_size(data[ii]) > ndx_) {
-                  unsigned short key = static_cast<unsigned short>(static_cast<unsigned char>(node_t::key_data(data[ii])[ndx_]));
-                  slots[key].push_back(ii);
-                  if(key < min_slot_)
-                     min_slot_ = key;
-                  if(key >= max_slot_)
-                     max_slot_ = key;
-               }
-               else // all keys with length less than selected index
-                  next_stage.push_back(ii);
-            }
-
-            int slot_count = slot_size(min_slot_, max_slot_);
-            nodes_ = new NodeT*[slot_count];
-            std::fill(nodes_, nodes_+slot_count, static_cast<NodeT*>(0));
-
-            for(std::size_t i = min_slot_; i <= max_slot_; ++i) {
-               insert_slot_data(slots[i], i);
-            }
-            insert_slot_data(next_stage, max_slot_+1);
+         const Key& key() const {
+            return key_;
          }
 
-         void insert_slot_data(const std::vector<std::size_t>& data, int index) {
-            if(!data.empty()) {
-               int ii = index-min_slot_;
-               nodes_[ii] = new NodeT();
-               nodes_[ii]->isLink_ = data.size() > 1;
-               if(nodes_[ii]->isLink_) {
-                  nodes_[ii]->data_.link_ = new node_t(data_, data);
-               }
-               else 
-                  nodes_[ii]->data_.tuple_ = &data_[data[0]];
-            }
-         }
+         Key key_;
+      };
 
-         // calculate column with maximum selectivity
-         std::size_t calc_best_index(const std::vector<std::size_t>& nodeIndexes) {
-            if(nodeIndexes.size() == 1)
-               return 0;
+      // specialization for std::string
+      template<>
+      struct MapKeyT<std::string> {
+         MapKeyT(const std::string& key)
+            : key_(key)
+         {}
 
-            // get length of largest string 
-            std::size_t max_sz = 0;
-            std::size_t min_sz = std::size_t(-1);
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         MapKeyT(std::string&& key)
+            : key_(std::move(key))
+         {}
+#endif
 
-            for(std::size_t i = 0, i_end = nodeIndexes.size(); i < i_end; ++i) {
-               std::size_t sz = node_t::key_size(data_[nodeIndexes[i]]);
-               if(sz > max_sz) 
-                  max_sz = sz;
-               if(sz < min_sz) 
-                  min_sz = sz;
-            }
+         std::size_t size() const {
+            return key_.size();
+         }
 
-            // get a column with maximum selectivity
-            // this starts from the end to avoid endless loop
-            // for prefix strings sequences. e.g. a, aa 
-            // where all columns have equal different char counts.
-            // to reduce memory consumption prefer columns with 
-            // small indexes and with small intervals of [min_val, max_val]
+         operator const char*() const {
+            return key_.c_str();
+         }
 
-            std::size_t min_slot_count = 256;
-            std::size_t max_count = 0;        
-            std::size_t best_ndx = 0;
-            for(int i = max_sz-1; i >=0; --i) {
-               std::set<byte_t> chars;			
-               for(std::size_t j = 0, j_end = nodeIndexes.size(); j < j_end; ++j) {
-                  int jj = nodeIndexes[j];
-                  if(node_t::key_size(data_[jj]) > static_cast<std::size_t>(i)) {
-                     chars.insert(static_cast<byte_t>(node_t::key_data(data_[jj])[i]));
-                  }
-               }
+         const std::string& key() const {
+            return key_;
+         }
 
-               std::size_t slot_count = static_cast<std::size_t>(*--chars.end()) - static_cast<std::size_t>(*chars.begin())+1;
-               std::size_t count = chars.size();
-               if(count > max_count || (count > 1 && count == max_count && slot_count <= min_slot_count)) {
-                  min_slot_count = slot_count;
-                  max_count = count;
-                  best_ndx = i;
-               }
-            }
+         std::string key_;
+      };
 
-            if(max_count == 1 && best_ndx < min_sz) 
-               throw std::range_error("static_radix_map::keys are not unique!");
+      // specialization for const char*
+      template<>
+      struct MapKeyT<const char*> {
+         MapKeyT(const char* key)
+            : key_(key)
+            , size_(std::strlen(key))
+         {}
 
-            return best_ndx;
+         std::size_t size() const {
+            return size_;
          }
 
-         Mapped value(const Key& key) const {
-            const value_type* p = this->tuple(key);
-            return p == 0 ? Mapped() : node_t::value(*p);
+         operator const char*() const {
+            return key_;
          }
 
-         Mapped& value_ref(const Key& key) {
-            value_type* p = this->tuple(key);
-            if(p != 0)
-               return node_t::value(*p);
-            else 
-               throw std::runtime_error("static_radix_map::value: key does not exists!");
+         const char* key() const {
+            return key_;
          }
 
-         int count(const Key& key) const {
-            return tuple(key) != 0;
-         }
+         const char* key_;
+         std::size_t size_;
+      };
 
-         // fixed length types
-         const value_type* tuple(const Key& key_param, boost::mpl::true_) const {	    
-            const char* key = to_const_char(key_param);
+      // seconds of a monotonic clock, processor time before C++11
+      inline double clock_seconds() {
+#ifdef STATIC_RADIX_MAP_HAS_CHRONO
+         return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+         return double(std::clock())/CLOCKS_PER_SEC;
+#endif
+      }
 
-            std::size_t slot = static_cast<byte_t>(key[ndx_]);
-            const NodeT* node = (slot >= min_slot_ && slot <= max_slot_) ? nodes_[slot-min_slot_] : 0;
+      // element types owning heap memory besides their sizeof
+      template<class T>
+      struct OwnsHeapT : boost::false_type {};
 
-            while(node  != 0 && node->isLink_) {
-               const node_t* mapNode = node->data_.link_;
-               std::size_t slot = static_cast<byte_t>(key[mapNode->ndx_]);
-               node = (slot >= mapNode->min_slot_ && slot <= mapNode->max_slot_) ? mapNode->nodes_[slot-mapNode->min_slot_] : 0;
-            }
+      template<>
+      struct OwnsHeapT<std::string> : boost::true_type {};
 
-            if(node != 0 && std::memcmp(key, node_t::key_data(*node->data_.tuple_), sizeof(Key)) == 0)
-               return node->data_.tuple_;
-            return 0;
-         }
+      template<class Key>
+      struct OwnsHeapT<MapKeyT<Key> > : OwnsHeapT<Key> {};
 
-         // fixed length types, querying only existing keys
-         const value_type* existing_tuple(const Key& key_param, boost::mpl::true_) const {	    
-            const char* key = to_const_char(key_param);
+      template<class T>
+      inline void add_heap(const T&, std::size_t&, std::size_t&) 
+      {}
 
-            std::size_t slot = static_cast<byte_t>(key[ndx_]);
-            const NodeT* node = nodes_[slot-min_slot_];
+      // strings longer than the small string buffer own a heap block
+      inline void add_heap(const std::string& str, std::size_t& bytes, std::size_t& blocks) {
+         if(str.capacity() > std::string().capacity()) {
+            bytes += str.capacity()+1;
+            ++blocks;
+         }
+      }
 
-            while(node->isLink_) {
-               const node_t* mapNode = node->data_.link_;
-               std::size_t slot = static_cast<byte_t>(key[mapNode->ndx_]);
-               node = mapNode->nodes_[slot-mapNode->min_slot_];
-            }
+      template<class Key>
+      inline void add_heap(const MapKeyT<Key>& key, std::size_t& bytes, std::size_t& blocks) {
+         add_heap(key.key(), bytes, blocks);
+      }
 
-            return node->data_.tuple_;
+      // capacity of a vector, elements are only visited if they own heap memory
+      template<class Vector>
+      inline void add_vector(const Vector& vec, std::size_t& bytes, std::size_t& blocks) {
+         typedef typename Vector::value_type value_type;
+         if(vec.capacity() > 0) {
+            bytes += vec.capacity()*sizeof(value_type);
+            ++blocks;
          }
+         if(OwnsHeapT<value_type>::value) {
+            for(std::size_t i = 0; i < vec.size(); ++i)
+               add_heap(vec[i], bytes, blocks);
+         }
+      }
 
-         // variable length types like std::string or const char*
-         const value_type* tuple(const Key& key_param, boost::mpl::false_) const {	    
-            std::size_t len = to_size(key_param);
-            const char* key = to_const_char(key_param);
+      template<class Key>
+      bool operator==(const MapKeyT<Key>& a, const MapKeyT<Key>& b) {
+         return a.key() == b.key();
+      }
 
-            const NodeT* node = 0;
-            if(ndx_ < len) {
-               std::size_t slot = static_cast<byte_t>(key[ndx_]);
-               node = (slot >= min_slot_ && slot <= max_slot_) ? nodes_[slot-min_slot_] : 0;
-            }
-            else 
-               node = nodes_[max_slot_-min_slot_+1];
+      template<class Key>
+      bool operator<(const MapKeyT<Key>& a, const MapKeyT<Key>& b) {
+         return a.key() < b.key();
+      }
 
-            while(node  != 0 && node->isLink_) {
-               const node_t* mapNode = node->data_.link_;
-               if(mapNode->ndx_ < len) {
-                  std::size_t slot = static_cast<byte_t>(key[mapNode->ndx_]);
-                  node = (slot >= mapNode->min_slot_ && slot <= mapNode->max_slot_) ? mapNode->nodes_[slot-mapNode->min_slot_] : 0;
-               }
-               else  
-                  node = mapNode->nodes_[mapNode->max_slot_ - mapNode->min_slot_+1];
-            }
+      // Mapped is const for const iterators. Converts to the value types of 
+      // std::vector and std::map, e.g. for std::map<Key, Mapped>(begin(), end()).
+      template<class Key, class Mapped>
+      struct MapRefT {
+         MapRefT(const Key& key, Mapped& value)
+            : first(key)
+            , second(value)
+         {}
 
-            if(node != 0 && len == node_t::key_size(*node->data_.tuple_)) {
-               if(std::memcmp(key, node_t::key_data(*node->data_.tuple_), len) == 0)
-                  return node->data_.tuple_;
-            }
-            return 0;
+         operator std::pair<Key, typename boost::remove_const<Mapped>::type>() const {
+            return std::pair<Key, typename boost::remove_const<Mapped>::type>(first, second);
          }
 
-         // variable length types like std::string or const char*, query existing keys
-         const value_type* existing_tuple(const Key& key_param, boost::mpl::false_) const {	    
-            std::size_t len = to_size(key_param);
-            const char* key = to_const_char(key_param);
+         operator std::pair<const Key, typename boost::remove_const<Mapped>::type>() const {
+            return std::pair<const Key, typename boost::remove_const<Mapped>::type>(first, second);
+         }
 
-            const NodeT* node = 0;
-            if(ndx_ < len) {
-               std::size_t slot = static_cast<byte_t>(key[ndx_]);
-               node = nodes_[slot-min_slot_];
-            }
-            else 
-               node = nodes_[max_slot_-min_slot_+1];
+         const Key& first;
+         Mapped& second;
+      };
 
-            while(node->isLink_) {
-               node_t* mapNode = node->data_.link_;
-               if(mapNode->ndx_ < len) {
-                  std::size_t slot = static_cast<byte_t>(key[mapNode->ndx_]);
-                  node = mapNode->nodes_[slot-mapNode->min_slot_];
-               }
-               else  
-                  node = mapNode->nodes_[mapNode->max_slot_ - mapNode->min_slot_+1];
-            }
+      template<class Storage, class Ref>
+      class SoaIteratorT 
+         : public boost::iterator_facade<SoaIteratorT<Storage, Ref>, typename Storage::value_type, boost::random_access_traversal_tag, Ref> 
+      {
+      public:
+         SoaIteratorT()
+            : storage_(0)
+            , pos_(0)
+         {}
+
+         SoaIteratorT(Storage* storage, std::size_t pos)
+            : storage_(storage)
+            , pos_(pos)
+         {}
+
+         // iterator to const_iterator
+         template<class S, class R>
+         SoaIteratorT(const SoaIteratorT<S, R>& other)
+            : storage_(other.storage())
+            , pos_(other.pos())
+         {}
 
-            return node->data_.tuple_;
+         Storage* storage() const {
+            return storage_;
          }
 
-         const value_type* tuple(const Key& key_param) const {	   
-            typedef boost::mpl::vector<std::string, const std::string, char*, const char*>	variable_length_types;
-            typedef boost::mpl::end<variable_length_types>::type end_type;
-            if(queryOnlyExistingKeys) 
-               return 
-                  existing_tuple(
-                     key_param, 
-                     typename boost::is_same<
-                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
-                     >::type()
-                  );
-            else
-               return 
-                  tuple(
-                     key_param, 
-                     typename boost::is_same<
-                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
-                     >::type()
-                  );
+         std::size_t pos() const {
+            return pos_;
          }
 
-         value_type* tuple(const Key& key) {	
-            return const_cast<value_type*>(static_cast<const node_t*>(this)->tuple(key));
+      private:
+         friend class boost::iterator_core_access;
+
+         Ref dereference() const {
+            return (*storage_)[pos_];
          }
 
-         std::size_t used_mem() const {
-            std::size_t res = sizeof(*this) + slot_size(min_slot_, max_slot_)*sizeof(NodeT*);
-            for(std::size_t i = 0, i_end = slot_size(min_slot_, max_slot_); i < i_end; ++i) {
-               if(nodes_[i] != 0) 
-                  res += nodes_[i]->size();
-            }
+         template<class S, class R>
+         bool equal(const SoaIteratorT<S, R>& other) const {
+            return pos_ == other.pos();
+         }
 
-            return res;
+         void increment() {
+            ++pos_;
          }
 
-         static inline std::size_t slot_size(std::size_t min_slot, std::size_t max_slot) {	   
-            return (max_slot > min_slot) ? max_slot-min_slot+2 : 0;
+         void decrement() {
+            --pos_;
          }
 
-         double average_path_length() const {
-            // sum of path lengths over all keys
-            typedef std::pair<const node_t*, int> element_t;
+         void advance(std::ptrdiff_t n) {
+            pos_ += n;
+         }
 
-            std::vector<element_t> stack;
-            stack.push_back(std::make_pair(this, 0));
-            int res = 0;
+         template<class S, class R>
+         std::ptrdiff_t distance_to(const SoaIteratorT<S, R>& other) const {
+            return static_cast<std::ptrdiff_t>(other.pos())-static_cast<std::ptrdiff_t>(pos_);
+         }
 
-            while(!stack.empty()) {
-               const element_t& e = stack.back();
-               const node_t* node = e.first;
-               int deep = e.second;
-               stack.pop_back();
+         Storage* storage_;
+         std::size_t pos_;
+      };
 
-               for(int i = node->min_slot_; i <= node->max_slot_; ++i) {
-                  int j = i-node->min_slot_;
-                  if(node->nodes_[j] != 0) {
-                     const NodeT* n = node->nodes_[j];
-                     if(n->isLink_)
-                        stack.push_back(std::make_pair(n->data_.link_, deep+1));
-                     else if(n->data_.tuple_ != 0) 
-                        res += deep;
-                  }
-               }
-            }
+      // Iterators and relational operators of the storages with proxy iterators, 
+      // built on size() and operator[] of Storage. Entries compare by the members 
+      // first and second of ConstRef, the storages lexicographically like std::vector.
+      template<class Storage, class Ref, class ConstRef>
+      class SoaStorageBaseT {
+      public:
+         typedef SoaIteratorT<Storage, Ref> iterator;
+         typedef SoaIteratorT<const Storage, ConstRef> const_iterator;
+         typedef boost::reverse_iterator<iterator> reverse_iterator;
+         typedef boost::reverse_iterator<const_iterator> const_reverse_iterator;
 
-            return (res*1.0)/data_.size();
+         iterator begin() {
+            return iterator(&storage(), 0);
          }
 
+         iterator end() {
+            return iterator(&storage(), storage().size());
+         }
 
-      private:
+         const_iterator begin() const {
+            return const_iterator(&storage(), 0);
+         }
 
-         struct NodeT {
-            NodeT() 
-            {
-               data_.link_ = 0;
-               isLink_ = false;
-            }
+         const_iterator end() const {
+            return const_iterator(&storage(), storage().size());
+         }
 
-            ~NodeT() {
-               if(isLink_)
-                  delete data_.link_;					
-            }
+         reverse_iterator rbegin() {
+            return reverse_iterator(end());
+         }
+
+         reverse_iterator rend() {
+            return reverse_iterator(begin());
+         }
+
+         const_reverse_iterator rbegin() const {
+            return const_reverse_iterator(end());
+         }
 
-            std::size_t size() const {
-               std::size_t res = sizeof(NodeT);
-               if(isLink_)
-                  res += data_.link_->used_mem();
+         const_reverse_iterator rend() const {
+            return const_reverse_iterator(begin());
+         }
 
-               return res;
+         bool operator==(const Storage& other) const {
+            if(storage().size() != other.size())
+               return false;
+            for(std::size_t i = 0; i < other.size(); ++i) {
+               ConstRef a = storage()[i];
+               ConstRef b = other[i];
+               if(!(a.first == b.first) || !(a.second == b.second))
+                  return false;
             }
+            return true;
+         }
 
-            union Link {
-               node_t* link_;
-               value_type* tuple_;
-            };
+         bool operator!=(const Storage& other) const {
+            return !(*this == other);
+         }
 
-            bool isLink_;
-            Link data_;
-         };
+         bool operator<(const Storage& other) const {
+            for(std::size_t i = 0, i_end = std::min(storage().size(), other.size()); i < i_end; ++i) {
+               ConstRef a = storage()[i];
+               ConstRef b = other[i];
+               if(a.first < b.first)
+                  return true;
+               if(b.first < a.first)
+                  return false;
+               if(a.second < b.second)
+                  return true;
+               if(b.second < a.second)
+                  return false;
+            }
+            return storage().size() < other.size();
+         }
 
-         std::size_t ndx_;
-         NodeT** nodes_;
-         std::vector<value_type>& data_;
-         unsigned short min_slot_;
-         unsigned short max_slot_;
+         bool operator>(const Storage& other) const {
+            return other < storage();
+         }
 
-         static inline const char* key_data(const value_type& tuple) {
-            return tuple;
+         bool operator<=(const Storage& other) const {
+            return !(other < storage());
          }
 
-         static inline std::size_t key_size(const value_type& tuple) {
-            return tuple.size();
+         bool operator>=(const Storage& other) const {
+            return !(*this < other);
          }
 
-         static inline Mapped& value(value_type& tuple) {
-            return tuple.value();
+      private:
+         Storage& storage() {
+            return static_cast<Storage&>(*this);
          }
 
-         static inline const Mapped& value(const value_type& tuple) {
-            return tuple.value();
+         const Storage& storage() const {
+            return static_cast<const Storage&>(*this);
          }
       };
 
-   } // namespace detail
-} // namespace static_map_stuff
-
+      // reorders a vector, element order[i] becomes element i
+      template<class Vector>
+      inline void permute_vector(Vector& vec, const std::vector<std::size_t>& order) {
+         Vector res(vec.get_allocator());
+         res.reserve(order.size());
+         for(std::size_t i = 0; i < order.size(); ++i) {
+#ifndef BOOST_NO_RVALUE_REFERENCES
+            res.push_back(std::move(vec[order[i]]));
+#else
+            res.push_back(vec[order[i]]);
 #endif
+         }
+         vec.swap(res);
+      }
+
+      // the subset of std::vector used by the map
+      template<class Key, class Mapped, class Allocator>
+      class SoaStorageT 
+         : public SoaStorageBaseT<SoaStorageT<Key, Mapped, Allocator>, MapRefT<Key, Mapped>, MapRefT<Key, const Mapped> > 
+      {
+      public:
+         typedef std::pair<Key, Mapped> value_type;
+         typedef MapKeyT<Key> key_type;
+         typedef std::vector<key_type, typename RebindT<Allocator, key_type>::type> KeyVectorT;
+         typedef std::vector<Mapped, typename RebindT<Allocator, Mapped>::type> MappedVectorT;
+         typedef MapRefT<Key, Mapped> reference;
+         typedef MapRefT<Key, const Mapped> const_reference;
+
+         explicit SoaStorageT(const Allocator& alloc = Allocator())
+            : keys_(alloc)
+            , values_(alloc)
+         {}
+
+         Allocator get_allocator() const {
+            return Allocator(keys_.get_allocator());
+         }
+
+         void reserve(std::size_t n) {
+            keys_.reserve(n);
+            values_.reserve(n);
+         }
+
+         void push_back(const value_type& value) {
+            keys_.push_back(key_type(value.first));
+            values_.push_back(value.second);
+         }
+
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         template<class K, class M>
+         void emplace_back(K&& key, M&& value) {
+            keys_.emplace_back(std::forward<K>(key));
+            values_.emplace_back(std::forward<M>(value));
+         }
+#endif
+
+         void clear() {
+            keys_.clear();
+            values_.clear();
+         }
+
+         std::size_t size() const {
+            return keys_.size();
+         }
+
+         std::size_t max_size() const {
+            return std::min(keys_.max_size(), values_.max_size());
+         }
+
+         bool empty() const {
+            return keys_.empty();
+         }
+
+         reference operator[](std::size_t i) {
+            return reference(keys_[i].key(), values_[i]);
+         }
+
+         const_reference operator[](std::size_t i) const {
+            return const_reference(keys_[i].key(), values_[i]);
+         }
+
+         const KeyVectorT& keys() const {
+            return keys_;
+         }
+
+         MappedVectorT& values() {
+            return values_;
+         }
+
+         const MappedVectorT& values() const {
+            return values_;
+         }
+
+         // entry order[i] becomes entry i
+         void permute(const std::vector<std::size_t>& order) {
+            permute_vector(keys_, order);
+            permute_vector(values_, order);
+         }
+
+         void add_mem(memory_usage& usage) const {
+            add_vector(keys_, usage.keys, usage.heap_blocks);
+            add_vector(values_, usage.values, usage.heap_blocks);
+         }
+
+      private:
+         KeyVectorT keys_;
+         MappedVectorT values_;
+      };
+
+      // Keys are only kept for building the tree, afterwards the storage is 
+      // the packed array of the mapped values and iterators yield Mapped&.
+      template<class Key, class Mapped, class Allocator>
+      class KeylessStorageT {
+      public:
+         typedef MapKeyT<Key> key_type;
+         typedef std::vector<key_type, typename RebindT<Allocator, key_type>::type> KeyVectorT;
+         typedef std::vector<Mapped, typename RebindT<Allocator, Mapped>::type> MappedVectorT;
+         typedef typename MappedVectorT::value_type value_type;
+         typedef typename MappedVectorT::iterator iterator;
+         typedef typename MappedVectorT::const_iterator const_iterator;
+         typedef typename MappedVectorT::reverse_iterator reverse_iterator;
+         typedef typename MappedVectorT::const_reverse_iterator const_reverse_iterator;
+
+         explicit KeylessStorageT(const Allocator& alloc = Allocator())
+            : keys_(alloc)
+            , values_(alloc)
+         {}
+
+         Allocator get_allocator() const {
+            return Allocator(values_.get_allocator());
+         }
+
+         void reserve(std::size_t n) {
+            keys_.reserve(n);
+            values_.reserve(n);
+         }
+
+         void push_back(const std::pair<Key, Mapped>& value) {
+            keys_.push_back(key_type(value.first));
+            values_.push_back(value.second);
+         }
+
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         template<class K, class M>
+         void emplace_back(K&& key, M&& value) {
+            keys_.emplace_back(std::forward<K>(key));
+            values_.emplace_back(std::forward<M>(value));
+         }
+#endif
+
+         void clear() {
+            keys_.clear();
+            values_.clear();
+         }
+
+         // releases the keys once the tree is built
+         void drop_keys() {
+            KeyVectorT(keys_.get_allocator()).swap(keys_);
+         }
+
+         std::size_t size() const {
+            return values_.size();
+         }
+
+         std::size_t max_size() const {
+            return values_.max_size();
+         }
+
+         bool empty() const {
+            return values_.empty();
+         }
+
+         iterator begin() {
+            return values_.begin();
+         }
+
+         iterator end() {
+            return values_.end();
+         }
+
+         const_iterator begin() const {
+            return values_.begin();
+         }
+
+         const_iterator end() const {
+            return values_.end();
+         }
+
+         reverse_iterator rbegin() {
+            return values_.rbegin();
+         }
+
+         reverse_iterator rend() {
+            return values_.rend();
+         }
+
+         const_reverse_iterator rbegin() const {
+            return values_.rbegin();
+         }
+
+         const_reverse_iterator rend() const {
+            return values_.rend();
+         }
+
+         const KeyVectorT& keys() const {
+            return keys_;
+         }
+
+         MappedVectorT& values() {
+            return values_;
+         }
+
+         const MappedVectorT& values() const {
+            return values_;
+         }
+
+         // entry order[i] becomes entry i
+         void permute(const std::vector<std::size_t>& order) {
+            permute_vector(keys_, order);
+            permute_vector(values_, order);
+         }
+
+         // the mapped values are compared, the keys are gone
+         bool operator==(const KeylessStorageT& other) const {
+            return values_ == other.values_;
+         }
+
+         bool operator!=(const KeylessStorageT& other) const {
+            return values_ != other.values_;
+         }
+
+         bool operator<(const KeylessStorageT& other) const {
+            return values_ < other.values_;
+         }
+
+         bool operator>(const KeylessStorageT& other) const {
+            return values_ > other.values_;
+         }
+
+         bool operator<=(const KeylessStorageT& other) const {
+            return values_ <= other.values_;
+         }
+
+         bool operator>=(const KeylessStorageT& other) const {
+            return values_ >= other.values_;
+         }
+
+         void add_mem(memory_usage& usage) const {
+            add_vector(keys_, usage.keys, usage.heap_blocks);
+            add_vector(values_, usage.values, usage.heap_blocks);
+         }
+
+      private:
+         KeyVectorT keys_;
+         MappedVectorT values_;
+      };
+
+      // Keyless storage verifying lookups by a hash of the keys. Keys sharing a 
+      // bucket could share their fingerprint, thus the tree must not have buckets.
+      template<class Key, class Mapped, class Fingerprint, class Allocator>
+      class FingerprintStorageT : public KeylessStorageT<Key, Mapped, Allocator> {
+      public:
+         typedef KeylessStorageT<Key, Mapped, Allocator> base_type;
+         typedef std::vector<Fingerprint, typename RebindT<Allocator, Fingerprint>::type> FingerprintVectorT;
+
+         BOOST_STATIC_ASSERT(sizeof(Fingerprint) <= 4);
+
+         explicit FingerprintStorageT(const Allocator& alloc = Allocator())
+            : base_type(alloc)
+            , fingerprints_(alloc)
+         {}
+
+         void clear() {
+            base_type::clear();
+            fingerprints_.clear();
+         }
+
+         // replaces the keys by their fingerprints
+         void drop_keys() {
+            fingerprints_.reserve(this->keys().size());
+            for(std::size_t i = 0; i < this->keys().size(); ++i)
+               fingerprints_.push_back(fingerprint(this->keys()[i], this->keys()[i].size()));
+            base_type::drop_keys();
+         }
+
+         const FingerprintVectorT& fingerprints() const {
+            return fingerprints_;
+         }
+
+         // FNV-1a with the murmur3 finalizer, the high bits are the fingerprint
+         static Fingerprint fingerprint(const char* key, std::size_t len) {
+            boost::uint32_t h = 2166136261u;
+            for(std::size_t i = 0; i < len; ++i)
+               h = (h ^ static_cast<unsigned char>(key[i])) * 16777619u;
+            h ^= h >> 16;
+            h *= 0x85ebca6bu;
+            h ^= h >> 13;
+            h *= 0xc2b2ae35u;
+            h ^= h >> 16;
+            return static_cast<Fingerprint>(h >> (32-8*sizeof(Fingerprint)));
+         }
+
+         void add_mem(memory_usage& usage) const {
+            base_type::add_mem(usage);
+            add_vector(fingerprints_, usage.keys, usage.heap_blocks);
+         }
+
+      private:
+         FingerprintVectorT fingerprints_;
+      };
+
+      // storages keeping their keys after the build, lookups comparing keys need them
+      template<class Storage>
+      struct KeepsKeysT : boost::true_type {};
+
+      template<class Key, class Mapped, class Allocator>
+      struct KeepsKeysT<KeylessStorageT<Key, Mapped, Allocator> > : boost::false_type {};
+
+      template<class Key, class Mapped, class Fingerprint, class Allocator>
+      struct KeepsKeysT<FingerprintStorageT<Key, Mapped, Fingerprint, Allocator> > : boost::false_type {};
+
+      // storages able to reject absent keys
+      template<class Storage>
+      struct VerifiesKeysT : KeepsKeysT<Storage> {};
+
+      template<class Key, class Mapped, class Fingerprint, class Allocator>
+      struct VerifiesKeysT<FingerprintStorageT<Key, Mapped, Fingerprint, Allocator> > : boost::true_type {};
+
+      // ----------------------------
+      // Packed values storage: the distinct mapped values are interned into a table, 
+      // each entry stores the id of its value in 1, 2, 4, 8 or 16 bits. Mapped needs 
+      // operator<. Writes go through a proxy, the table never shrinks.
+
+      template<class Storage, class Mapped>
+      class PackedValueRefT {
+      public:
+         PackedValueRefT(Storage& storage, std::size_t i)
+            : storage_(&storage)
+            , i_(i)
+         {}
+
+         // copies refer to the same value, assignment writes through
+         PackedValueRefT(const PackedValueRefT& other)
+            : storage_(other.storage_)
+            , i_(other.i_)
+         {}
+
+         operator const Mapped&() const {
+            return storage_->value(i_);
+         }
+
+         const Mapped& get() const {
+            return storage_->value(i_);
+         }
+
+         PackedValueRefT& operator=(const Mapped& value) {
+            storage_->set_value(i_, value);
+            return *this;
+         }
+
+         PackedValueRefT& operator=(const PackedValueRefT& other) {
+            storage_->set_value(i_, other.storage_->value(other.i_));
+            return *this;
+         }
+
+      private:
+         Storage* storage_;
+         std::size_t i_;
+      };
+
+      // iterator reference of packed values, second is a write proxy
+      template<class Key, class Mapped, class Proxy>
+      struct ProxyRefT {
+         ProxyRefT(const Key& key, const Proxy& value)
+            : first(key)
+            , second(value)
+         {}
+
+         operator std::pair<Key, Mapped>() const {
+            return std::pair<Key, Mapped>(first, Mapped(second));
+         }
+
+         operator std::pair<const Key, Mapped>() const {
+            return std::pair<const Key, Mapped>(first, Mapped(second));
+         }
+
+         const Key& first;
+         Proxy second;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      class PackedStorageT 
+         : public SoaStorageBaseT<PackedStorageT<Key, Mapped, Allocator>, ProxyRefT<Key, Mapped, PackedValueRefT<PackedStorageT<Key, Mapped, Allocator>, Mapped> >, MapRefT<Key, const Mapped> > 
+      {
+      public:
+         typedef std::pair<Key, Mapped> value_type;
+         typedef MapKeyT<Key> key_type;
+         typedef std::vector<key_type, typename RebindT<Allocator, key_type>::type> KeyVectorT;
+         typedef std::vector<Mapped, typename RebindT<Allocator, Mapped>::type> MappedVectorT;
+         typedef std::vector<boost::uint16_t, typename RebindT<Allocator, boost::uint16_t>::type> IdVectorT;
+         typedef std::vector<boost::uint64_t, typename RebindT<Allocator, boost::uint64_t>::type> WordVectorT;
+         typedef PackedValueRefT<PackedStorageT, Mapped> mapped_reference;
+         typedef ProxyRefT<Key, Mapped, mapped_reference> reference;
+         typedef MapRefT<Key, const Mapped> const_reference;
+
+         static const std::size_t MAX_BITS = 16;
+
+         explicit PackedStorageT(const Allocator& alloc = Allocator())
+            : keys_(alloc)
+            , table_(alloc)
+            , sorted_(alloc)
+            , words_(alloc)
+            , bits_(1)
+         {}
+
+         Allocator get_allocator() const {
+            return Allocator(keys_.get_allocator());
+         }
+
+         void reserve(std::size_t n) {
+            keys_.reserve(n);
+         }
+
+         void push_back(const value_type& value) {
+            std::size_t id = intern(value.second);
+            keys_.push_back(key_type(value.first));
+            append_id(id);
+         }
+
+#ifndef BOOST_NO_RVALUE_REFERENCES
+         template<class K, class M>
+         void emplace_back(K&& key, M&& value) {
+            std::size_t id = intern(value);
+            keys_.emplace_back(std::forward<K>(key));
+            append_id(id);
+         }
+#endif
+
+         void clear() {
+            keys_.clear();
+            table_.clear();
+            sorted_.clear();
+            words_.clear();
+            bits_ = 1;
+         }
+
+         std::size_t size() const {
+            return keys_.size();
+         }
+
+         std::size_t max_size() const {
+            return keys_.max_size();
+         }
+
+         bool empty() const {
+            return keys_.empty();
+         }
+
+         reference operator[](std::size_t i) {
+            return reference(keys_[i].key(), mapped_reference(*this, i));
+         }
+
+         const_reference operator[](std::size_t i) const {
+            return const_reference(keys_[i].key(), value(i));
+         }
+
+         const KeyVectorT& keys() const {
+            return keys_;
+         }
+
+         // the distinct mapped values
+         const MappedVectorT& mapped_table() const {
+            return table_;
+         }
+
+         // bits per entry
+         std::size_t bits() const {
+            return bits_;
+         }
+
+         const Mapped& value(std::size_t i) const {
+            return table_[id(i)];
+         }
+
+         void set_value(std::size_t i, const Mapped& value) {
+            std::size_t new_id = intern(value);
+            set_id(i, new_id);
+         }
+
+         // entry order[i] becomes entry i
+         void permute(const std::vector<std::size_t>& order) {
+            std::vector<std::size_t> ids(order.size());
+            for(std::size_t i = 0; i < order.size(); ++i)
+               ids[i] = id(order[i]);
+            permute_vector(keys_, order);
+            for(std::size_t i = 0; i < ids.size(); ++i)
+               set_id(i, ids[i]);
+         }
+
+         void add_mem(memory_usage& usage) const {
+            add_vector(keys_, usage.keys, usage.heap_blocks);
+            add_vector(table_, usage.values, usage.heap_blocks);
+            add_vector(sorted_, usage.values, usage.heap_blocks);
+            add_vector(words_, usage.values, usage.heap_blocks);
+         }
+
+      private:
+         // order of table ids by their values
+         struct IdLess {
+            explicit IdLess(const MappedVectorT& table)
+               : table_(&table)
+            {}
+
+            bool operator()(boost::uint16_t id, const Mapped& value) const {
+               return (*table_)[id] < value;
+            }
+
+            const MappedVectorT* table_;
+         };
+
+         // the widths divide 64, thus ids never cross words
+         std::size_t id(std::size_t i) const {
+            std::size_t bit = i*bits_;
+            return static_cast<std::size_t>(words_[bit/64] >> bit%64) & ((std::size_t(1) << bits_)-1);
+         }
+
+         void set_id(std::size_t i, std::size_t id) {
+            std::size_t bit = i*bits_;
+            boost::uint64_t mask = (boost::uint64_t(1) << bits_)-1;
+            words_[bit/64] = (words_[bit/64] & ~(mask << bit%64)) | boost::uint64_t(id) << bit%64;
+         }
+
+         // id of the last key
+         void append_id(std::size_t id) {
+            words_.resize((keys_.size()*bits_+63)/64);
+            set_id(keys_.size()-1, id);
+         }
+
+         // id of a value, new values are appended to the table
+         std::size_t intern(const Mapped& value) {
+            typename IdVectorT::iterator iter = std::lower_bound(sorted_.begin(), sorted_.end(), value, IdLess(table_));
+            if(iter != sorted_.end() && !(value < table_[*iter]))
+               return *iter;
+            if(table_.size() >> MAX_BITS != 0)
+               throw std::range_error("static_radix_map::too many distinct mapped values!");
+
+            std::size_t res = table_.size();
+            sorted_.insert(iter, static_cast<boost::uint16_t>(res));
+            table_.push_back(value);
+            if(res >> bits_ != 0)
+               widen();
+            return res;
+         }
+
+         // doubles the bits per entry
+         void widen() {
+            std::vector<std::size_t> ids(keys_.size());
+            for(std::size_t i = 0; i < ids.size(); ++i)
+               ids[i] = id(i);
+            bits_ *= 2;
+            words_.assign((ids.size()*bits_+63)/64, 0);
+            for(std::size_t i = 0; i < ids.size(); ++i)
+               set_id(i, ids[i]);
+         }
+
+         KeyVectorT keys_;
+         MappedVectorT table_;
+         IdVectorT sorted_;
+         WordVectorT words_;
+         std::size_t bits_;
+      };
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      // ----------------------------
+      // String arena storage: the mapped strings are spans of one char array. 
+      // A longer string written to an entry is appended, the old bytes stay unused.
+
+      template<class Storage>
+      class ArenaValueRefT {
+      public:
+         ArenaValueRefT(Storage& storage, std::size_t i)
+            : storage_(&storage)
+            , i_(i)
+         {}
+
+         // copies refer to the same value, assignment writes through
+         ArenaValueRefT(const ArenaValueRefT& other)
+            : storage_(other.storage_)
+            , i_(other.i_)
+         {}
+
+         operator std::string_view() const {
+            return storage_->value(i_);
+         }
+
+         std::string_view get() const {
+            return storage_->value(i_);
+         }
+
+         ArenaValueRefT& operator=(std::string_view value) {
+            storage_->set_value(i_, value);
+            return *this;
+         }
+
+         ArenaValueRefT& operator=(const ArenaValueRefT& other) {
+            storage_->set_value(i_, other.get());
+            return *this;
+         }
+
+      private:
+         Storage* storage_;
+         std::size_t i_;
+      };
+
+      template<class Key, class Allocator>
+      class StringArenaStorageT 
+         : public SoaStorageBaseT<StringArenaStorageT<Key, Allocator>, ProxyRefT<Key, std::string, ArenaValueRefT<StringArenaStorageT<Key, Allocator> > >, ProxyRefT<Key, std::string, std::string_view> > 
+      {
+      public:
+         typedef std::pair<Key, std::string> value_type;
+         typedef MapKeyT<Key> key_type;
+         typedef std::vector<key_type, typename RebindT<Allocator, key_type>::type> KeyVectorT;
+         typedef std::vector<char, typename RebindT<Allocator, char>::type> CharVectorT;
+         typedef ArenaValueRefT<StringArenaStorageT> mapped_reference;
+         typedef ProxyRefT<Key, std::string, mapped_reference> reference;
+         typedef ProxyRefT<Key, std::string, std::string_view> const_reference;
+
+         // position and length of a string in the arena
+         struct SpanT {
+            std::size_t first_;
+            std::size_t size_;
+         };
+         typedef std::vector<SpanT, typename RebindT<Allocator, SpanT>::type> SpanVectorT;
+
+         explicit StringArenaStorageT(const Allocator& alloc = Allocator())
+            : keys_(alloc)
+            , spans_(alloc)
+            , arena_(alloc)
+         {}
+
+         Allocator get_allocator() const {
+            return Allocator(keys_.get_allocator());
+         }
+
+         void reserve(std::size_t n) {
+            keys_.reserve(n);
+            spans_.reserve(n);
+         }
+
+         void push_back(const value_type& value) {
+            keys_.push_back(key_type(value.first));
+            append(value.second);
+         }
+
+         template<class K, class M>
+         void emplace_back(K&& key, M&& value) {
+            keys_.emplace_back(std::forward<K>(key));
+            append(std::string_view(value));
+         }
+
+         void clear() {
+            keys_.clear();
+            spans_.clear();
+            arena_.clear();
+         }
+
+         std::size_t size() const {
+            return keys_.size();
+         }
+
+         std::size_t max_size() const {
+            return keys_.max_size();
+         }
+
+         bool empty() const {
+            return keys_.empty();
+         }
+
+         reference operator[](std::size_t i) {
+            return reference(keys_[i].key(), mapped_reference(*this, i));
+         }
+
+         const_reference operator[](std::size_t i) const {
+            return const_reference(keys_[i].key(), value(i));
+         }
+
+         const KeyVectorT& keys() const {
+            return keys_;
+         }
+
+         const CharVectorT& arena() const {
+            return arena_;
+         }
+
+         std::string_view value(std::size_t i) const {
+            return std::string_view(arena_.data()+spans_[i].first_, spans_[i].size_);
+         }
+
+         void shrink_to_fit() {
+            CharVectorT(arena_.begin(), arena_.end(), arena_.get_allocator()).swap(arena_);
+         }
+
+         // strings fitting the old span are written in place, longer ones are appended 
+         // and may reallocate the arena, the old span is left unused until compact()
+         void set_value(std::size_t i, std::string_view value) {
+            if(value.size() <= spans_[i].size_) {
+               std::memmove(arena_.data()+spans_[i].first_, value.data(), value.size());
+               spans_[i].size_ = value.size();
+            }
+            else {
+               std::string copy(value); // value may be a view into the arena
+               spans_[i].first_ = arena_.size();
+               spans_[i].size_ = copy.size();
+               arena_.insert(arena_.end(), copy.begin(), copy.end());
+            }
+         }
+
+         // rewrites the arena in entry order without the spans left by set_value()
+         void compact() {
+            std::size_t total = 0;
+            for(std::size_t i = 0; i < spans_.size(); ++i)
+               total += spans_[i].size_;
+
+            CharVectorT arena(arena_.get_allocator());
+            arena.reserve(total);
+            for(std::size_t i = 0; i < spans_.size(); ++i) {
+               std::size_t first = arena.size();
+               arena.insert(arena.end(), arena_.begin()+spans_[i].first_, arena_.begin()+spans_[i].first_+spans_[i].size_);
+               spans_[i].first_ = first;
+            }
+            arena_.swap(arena);
+         }
+
+         // entry order[i] becomes entry i, the arena keeps its order
+         void permute(const std::vector<std::size_t>& order) {
+            permute_vector(keys_, order);
+            permute_vector(spans_, order);
+         }
+
+         void add_mem(memory_usage& usage) const {
+            add_vector(keys_, usage.keys, usage.heap_blocks);
+            add_vector(spans_, usage.values, usage.heap_blocks);
+            add_vector(arena_, usage.values, usage.heap_blocks);
+         }
+
+      private:
+         void append(std::string_view value) {
+            SpanT span;
+            span.first_ = arena_.size();
+            span.size_ = value.size();
+            spans_.push_back(span);
+            arena_.insert(arena_.end(), value.begin(), value.end());
+         }
+
+         KeyVectorT keys_;
+         SpanVectorT spans_;
+         CharVectorT arena_;
+      };
+
+      // key of an arena entry, compared by the tree like MapKeyT
+      struct ArenaKeyT {
+         ArenaKeyT(const char* key, std::size_t size)
+            : key_(key)
+            , size_(size)
+         {}
+
+         std::size_t size() const {
+            return size_;
+         }
+
+         operator const char*() const {
+            return key_;
+         }
+
+         const char* key_;
+         std::size_t size_;
+      };
+
+      // iterator reference of arena keys, Mapped is const for const iterators
+      template<class Mapped>
+      struct ArenaKeyRefT {
+         ArenaKeyRefT(std::string_view key, Mapped& value)
+            : first(key)
+            , second(value)
+         {}
+
+         operator std::pair<std::string, typename boost::remove_const<Mapped>::type>() const {
+            return std::pair<std::string, typename boost::remove_const<Mapped>::type>(std::string(first), second);
+         }
+
+         operator std::pair<const std::string, typename boost::remove_const<Mapped>::type>() const {
+            return std::pair<const std::string, typename boost::remove_const<Mapped>::type>(std::string(first), second);
+         }
+
+         std::string_view first;
+         Mapped& second;
+      };
+
+      // std::string keys back to back in one char array, each followed by '\0'
+      template<class Mapped, class Allocator>
+      class KeyArenaStorageT 
+         : public SoaStorageBaseT<KeyArenaStorageT<Mapped, Allocator>, ArenaKeyRefT<Mapped>, ArenaKeyRefT<const Mapped> > 
+      {
+      public:
+         typedef std::pair<std::string, Mapped> value_type;
+         typedef std::vector<char, typename RebindT<Allocator, char>::type> CharVectorT;
+         typedef std::vector<std::size_t, typename RebindT<Allocator, std::size_t>::type> OffsetVectorT;
+         typedef std::vector<Mapped, typename RebindT<Allocator, Mapped>::type> MappedVectorT;
+         typedef ArenaKeyRefT<Mapped> reference;
+         typedef ArenaKeyRefT<const Mapped> const_reference;
+
+         explicit KeyArenaStorageT(const Allocator& alloc = Allocator())
+            : arena_(alloc)
+            , offsets_(alloc)
+            , values_(alloc)
+         {}
+
+         Allocator get_allocator() const {
+            return Allocator(values_.get_allocator());
+         }
+
+         void reserve(std::size_t n) {
+            offsets_.reserve(n+1);
+            values_.reserve(n);
+         }
+
+         void push_back(const value_type& value) {
+            append(value.first);
+            values_.push_back(value.second);
+         }
+
+         template<class K, class M>
+         void emplace_back(K&& key, M&& value) {
+            append(std::string_view(key));
+            values_.emplace_back(std::forward<M>(value));
+         }
+
+         void clear() {
+            arena_.clear();
+            offsets_.clear();
+            values_.clear();
+         }
+
+         std::size_t size() const {
+            return values_.size();
+         }
+
+         std::size_t max_size() const {
+            return values_.max_size();
+         }
+
+         bool empty() const {
+            return values_.empty();
+         }
+
+         reference operator[](std::size_t i) {
+            return reference(key(i), values_[i]);
+         }
+
+         const_reference operator[](std::size_t i) const {
+            return const_reference(key(i), values_[i]);
+         }
+
+         // key i is arena_[offsets_[i], offsets_[i+1]-1)
+         std::string_view key(std::size_t i) const {
+            return std::string_view(arena_.data()+offsets_[i], offsets_[i+1]-offsets_[i]-1);
+         }
+
+         const CharVectorT& arena() const {
+            return arena_;
+         }
+
+         const OffsetVectorT& offsets() const {
+            return offsets_;
+         }
+
+         MappedVectorT& values() {
+            return values_;
+         }
+
+         const MappedVectorT& values() const {
+            return values_;
+         }
+
+         void shrink_to_fit() {
+            CharVectorT(arena_.begin(), arena_.end(), arena_.get_allocator()).swap(arena_);
+            OffsetVectorT(offsets_.begin(), offsets_.end(), offsets_.get_allocator()).swap(offsets_);
+         }
+
+         // entry order[i] becomes entry i, the arena is rewritten in the new order
+         void permute(const std::vector<std::size_t>& order) {
+            KeyArenaStorageT res(get_allocator());
+            res.arena_.reserve(arena_.size());
+            res.reserve(order.size());
+            for(std::size_t i = 0; i < order.size(); ++i) {
+               res.append(key(order[i]));
+               res.values_.push_back(std::move(values_[order[i]]));
+            }
+            swap(res);
+         }
+
+         void swap(KeyArenaStorageT& other) {
+            arena_.swap(other.arena_);
+            offsets_.swap(other.offsets_);
+            values_.swap(other.values_);
+         }
+
+         void add_mem(memory_usage& usage) const {
+            add_vector(arena_, usage.keys, usage.heap_blocks);
+            add_vector(offsets_, usage.keys, usage.heap_blocks);
+            add_vector(values_, usage.values, usage.heap_blocks);
+         }
+
+      private:
+         void append(std::string_view key) {
+            if(offsets_.empty())
+               offsets_.push_back(0);
+            arena_.insert(arena_.end(), key.begin(), key.end());
+            arena_.push_back('\0');
+            offsets_.push_back(arena_.size());
+         }
+
+         CharVectorT arena_;
+         OffsetVectorT offsets_;
+         MappedVectorT values_;
+      };
+#endif
+
+      // reference, const reference and value types of the mapped values of a storage
+      template<class Storage, class Mapped>
+      struct MappedTypesT {
+         typedef Mapped& reference;
+         typedef const Mapped& const_reference;
+         typedef Mapped value;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct MappedTypesT<PackedStorageT<Key, Mapped, Allocator>, Mapped> {
+         typedef typename PackedStorageT<Key, Mapped, Allocator>::mapped_reference reference;
+         typedef const Mapped& const_reference;
+         typedef Mapped value;
+      };
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Key, class Allocator>
+      struct MappedTypesT<StringArenaStorageT<Key, Allocator>, std::string> {
+         typedef typename StringArenaStorageT<Key, Allocator>::mapped_reference reference;
+         typedef std::string_view const_reference;
+         typedef std::string_view value;
+      };
+#endif
+
+      // the array of mapped values of storages keeping them apart from the keys. 
+      // Other storages name the same vector type, their mapped_values() is never instantiated.
+      template<class Storage, class Mapped, class Allocator>
+      struct MappedVectorOfT {
+         typedef std::vector<Mapped, typename RebindT<Allocator, Mapped>::type> type;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct MappedVectorOfT<SoaStorageT<Key, Mapped, Allocator>, Mapped, Allocator> {
+         typedef typename SoaStorageT<Key, Mapped, Allocator>::MappedVectorT type;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct MappedVectorOfT<KeylessStorageT<Key, Mapped, Allocator>, Mapped, Allocator> {
+         typedef typename KeylessStorageT<Key, Mapped, Allocator>::MappedVectorT type;
+      };
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Mapped, class Allocator>
+      struct MappedVectorOfT<KeyArenaStorageT<Mapped, Allocator>, Mapped, Allocator> {
+         typedef typename KeyArenaStorageT<Mapped, Allocator>::MappedVectorT type;
+      };
+#endif
+
+      template<class Key, class Mapped, class Layout, class Allocator>
+      struct StorageOfT {
+         typedef std::vector<MapDataT<Key, Mapped>, typename RebindT<Allocator, MapDataT<Key, Mapped> >::type> type;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct StorageOfT<Key, Mapped, soa_layout, Allocator> {
+         typedef SoaStorageT<Key, Mapped, Allocator> type;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct StorageOfT<Key, Mapped, keyless_layout, Allocator> {
+         typedef KeylessStorageT<Key, Mapped, Allocator> type;
+      };
+
+      template<class Key, class Mapped, class Allocator>
+      struct StorageOfT<Key, Mapped, packed_values_layout, Allocator> {
+         typedef PackedStorageT<Key, Mapped, Allocator> type;
+      };
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Key, class Allocator>
+      struct StorageOfT<Key, std::string, string_arena_layout, Allocator> {
+         typedef StringArenaStorageT<Key, Allocator> type;
+      };
+
+      // only std::string keys are kept in the arena
+      template<class Key, class Mapped, class Allocator>
+      struct StorageOfT<Key, Mapped, key_arena_layout, Allocator>;
+
+      template<class Mapped, class Allocator>
+      struct StorageOfT<std::string, Mapped, key_arena_layout, Allocator> {
+         typedef KeyArenaStorageT<Mapped, Allocator> type;
+      };
+#endif
+
+      template<class Key, class Mapped, class Fingerprint, class Allocator>
+      struct StorageOfT<Key, Mapped, fingerprint_layout<Fingerprint>, Allocator> {
+         typedef FingerprintStorageT<Key, Mapped, Fingerprint, Allocator> type;
+      };
+
+      // key and mapped value of the i-th entry of a storage
+      template<class Key, class Mapped, class A>
+      inline const MapDataT<Key, Mapped>& entry_key(const std::vector<MapDataT<Key, Mapped>, A>& data, std::size_t i) {
+         return data[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline Mapped& entry_value(std::vector<MapDataT<Key, Mapped>, A>& data, std::size_t i) {
+         return data[i].value();
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const Mapped& entry_value(const std::vector<MapDataT<Key, Mapped>, A>& data, std::size_t i) {
+         return data[i].value();
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const MapKeyT<Key>& entry_key(const SoaStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.keys()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline Mapped& entry_value(SoaStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const Mapped& entry_value(const SoaStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+
+      // reorders the entries, entry order[i] becomes entry i
+      template<class Storage>
+      inline void permute_entries(Storage& data, const std::vector<std::size_t>& order) {
+         data.permute(order);
+      }
+
+      template<class Key, class Mapped, class A>
+      inline void permute_entries(std::vector<MapDataT<Key, Mapped>, A>& data, const std::vector<std::size_t>& order) {
+         permute_vector(data, order);
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const MapKeyT<Key>& entry_key(const KeylessStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.keys()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline Mapped& entry_value(KeylessStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const Mapped& entry_value(const KeylessStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const MapKeyT<Key>& entry_key(const PackedStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.keys()[i];
+      }
+
+      template<class Key, class Mapped, class A>
+      inline PackedValueRefT<PackedStorageT<Key, Mapped, A>, Mapped> entry_value(PackedStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return PackedValueRefT<PackedStorageT<Key, Mapped, A>, Mapped>(data, i);
+      }
+
+      template<class Key, class Mapped, class A>
+      inline const Mapped& entry_value(const PackedStorageT<Key, Mapped, A>& data, std::size_t i) {
+         return data.value(i);
+      }
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Key, class A>
+      inline const MapKeyT<Key>& entry_key(const StringArenaStorageT<Key, A>& data, std::size_t i) {
+         return data.keys()[i];
+      }
+
+      template<class Key, class A>
+      inline ArenaValueRefT<StringArenaStorageT<Key, A> > entry_value(StringArenaStorageT<Key, A>& data, std::size_t i) {
+         return ArenaValueRefT<StringArenaStorageT<Key, A> >(data, i);
+      }
+
+      template<class Key, class A>
+      inline std::string_view entry_value(const StringArenaStorageT<Key, A>& data, std::size_t i) {
+         return data.value(i);
+      }
+
+      template<class Mapped, class A>
+      inline ArenaKeyT entry_key(const KeyArenaStorageT<Mapped, A>& data, std::size_t i) {
+         std::string_view key = data.key(i);
+         return ArenaKeyT(key.data(), key.size());
+      }
+
+      template<class Mapped, class A>
+      inline Mapped& entry_value(KeyArenaStorageT<Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+
+      template<class Mapped, class A>
+      inline const Mapped& entry_value(const KeyArenaStorageT<Mapped, A>& data, std::size_t i) {
+         return data.values()[i];
+      }
+#endif
+
+      // the keys are released after the build, a no-op for storages keeping them
+      template<class Storage>
+      inline void drop_keys(Storage&) 
+      {}
+
+      template<class Key, class Mapped, class A>
+      inline void drop_keys(KeylessStorageT<Key, Mapped, A>& data) {
+         data.drop_keys();
+      }
+
+      template<class Key, class Mapped, class F, class A>
+      inline void drop_keys(FingerprintStorageT<Key, Mapped, F, A>& data) {
+         data.drop_keys();
+      }
+
+      // adds the key and value bytes of a storage to usage
+      template<class Storage>
+      inline void storage_mem(const Storage& data, memory_usage& usage) {
+         data.add_mem(usage);
+      }
+
+      // the padding of the pairs counts to the values
+      template<class Key, class Mapped, class A>
+      inline void storage_mem(const std::vector<MapDataT<Key, Mapped>, A>& data, memory_usage& usage) {
+         if(data.capacity() > 0) {
+            usage.keys += data.capacity()*sizeof(Key);
+            usage.values += data.capacity()*(sizeof(MapDataT<Key, Mapped>)-sizeof(Key));
+            ++usage.heap_blocks;
+         }
+         if(OwnsHeapT<Key>::value || OwnsHeapT<Mapped>::value) {
+            for(std::size_t i = 0; i < data.size(); ++i) {
+               add_heap(data[i].first, usage.keys, usage.heap_blocks);
+               add_heap(data[i].second, usage.values, usage.heap_blocks);
+            }
+         }
+      }
+
+      // bytes of a storage counted by used_mem(): the key arena of key_arena_layout, 
+      // which replaces the key objects as the data the lookups compare
+      template<class Storage>
+      inline std::size_t index_mem(const Storage&) {
+         return 0;
+      }
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Mapped, class A>
+      inline std::size_t index_mem(const KeyArenaStorageT<Mapped, A>& data) {
+         return data.arena().capacity()+data.offsets().capacity()*sizeof(std::size_t);
+      }
+#endif
+
+      // releases the slack of storages growing while filled, a no-op by default
+      template<class Storage>
+      inline void shrink_entries(Storage&) 
+      {}
+
+#ifdef STATIC_RADIX_MAP_HAS_STRING_VIEW
+      template<class Key, class A>
+      inline void shrink_entries(StringArenaStorageT<Key, A>& data) {
+         data.shrink_to_fit();
+      }
+
+      template<class Mapped, class A>
+      inline void shrink_entries(KeyArenaStorageT<Mapped, A>& data) {
+         data.shrink_to_fit();
+      }
+#endif
+
+      // compares a key with the key of entry i
+      template<class Storage>
+      inline bool entry_equal(const Storage& data, std::size_t i, const char* key, std::size_t len) {
+         return len == entry_key(data, i).size() && std::memcmp(key, entry_key(data, i), len) == 0;
+      }
+
+      template<class Key, class Mapped, class F, class A>
+      inline bool entry_equal(const FingerprintStorageT<Key, Mapped, F, A>& data, std::size_t i, const char* key, std::size_t len) {
+         return data.fingerprints()[i] == data.fingerprint(key, len);
+      }
+
+      // --------------------------------------------------------------------------------------------
+
+      // Index is the integer type of the slots and node headers: boost::uint16_t for 
+      // up to 16383 keys and 65535 slots, boost::uint32_t, or std::size_t.
+      template<typename Key, typename Mapped, bool queryOnlyExistingKeys = false, typename TupleVectorT = std::vector<MapDataT<Key, Mapped> >, typename Allocator = std::allocator<char>, typename Index = std::size_t>
+      class static_radix_map_node : boost::noncopyable  
+      {
+      public:
+         static const std::size_t MAX_SLOTS = 257;
+         static const std::size_t NO_FIXED_DEPTH = std::size_t(-1);
+         static const std::size_t DATA_BITS = sizeof(Index)*8-2;
+         static const std::size_t NO_TUPLE = (std::size_t(1) << DATA_BITS)-1;
+         static const std::size_t MAX_INDEX = static_cast<std::size_t>(Index(-1));
+         typedef unsigned char byte_t;
+         // column type of the node headers, 16 bit up to 32 bit Index
+         typedef typename boost::mpl::if_c<(sizeof(Index) > 4), boost::uint32_t, boost::uint16_t>::type ColumnT;
+         static const std::size_t MAX_COLUMN = static_cast<std::size_t>(ColumnT(-1));
+         typedef typename TupleVectorT::value_type value_type;
+         typedef typename MappedTypesT<TupleVectorT, Mapped>::reference mapped_reference;
+         typedef typename MappedTypesT<TupleVectorT, Mapped>::const_reference const_mapped_reference;
+         typedef typename MappedTypesT<TupleVectorT, Mapped>::value mapped_value;
+
+         typedef typename boost::remove_const<Key>::type	KeyBase;
+         typedef static_radix_map_node<Key, Mapped, queryOnlyExistingKeys, TupleVectorT, Allocator, Index> node_t;
+         typedef boost::mpl::vector<std::string, const std::string, char*, const char*>	variable_length_types;
+
+         // Small fixed length keys can be inlined in the high bits of their leaf slots, 
+         // the tuple index keeps at least 20 bits.
+         static const std::size_t INLINE_KEY_BITS = 
+            !queryOnlyExistingKeys && sizeof(Key)*8+20 <= DATA_BITS &&
+            boost::is_same<typename boost::mpl::find<variable_length_types, Key>::type, typename boost::mpl::end<variable_length_types>::type>::value 
+               ? sizeof(Key)*8 : 0;
+         static const std::size_t TUPLE_BITS = DATA_BITS-INLINE_KEY_BITS;
+         static const std::size_t TUPLE_MASK = (std::size_t(1) << TUPLE_BITS)-1;
+
+         // links of shared subtrees: header index in the low bits, offset above
+         static const std::size_t LINK_BITS = DATA_BITS/2;
+         static const std::size_t LINK_MASK = (std::size_t(1) << LINK_BITS)-1;
+
+         // The whole tree is kept in two arrays: the node headers with the root first 
+         // and the slots of all nodes. Links and leaves are indexes into these arrays 
+         // and into data. The arrays of the tree use alloc, temporary build data 
+         // the standard allocator.
+         static_radix_map_node(TupleVectorT& data, const std::vector<std::size_t>& nodeIndexes, const build_options& options = build_options(), const Allocator& alloc = Allocator()) 
+            : headers_(alloc)
+            , slots_(alloc)
+            , buckets_(alloc)
+            , bucket_tuples_(alloc)
+            , table_(alloc)
+            , data_(&data)     
+            , depth_(NO_FIXED_DEPTH)
+            , inline_keys_(options.inline_keys_ && INLINE_KEY_BITS != 0 && data.size() < TUPLE_MASK)
+            , link_mask_(NO_TUPLE)
+            , root_offset_(0)
+         {
+            initialize(nodeIndexes, options);
+            if(options.fixed_depth_ && queryOnlyExistingKeys) {
+               depth_ = max_path_length();
+               pad_leaves(depth_);
+            }
+            if(options.node_order_ != depth_first_nodes || options.weighted_order_)
+               reorder_nodes(options.node_order_, options.weighted_order_);
+            if(options.root_table_bytes_ > 0 && depth_ == NO_FIXED_DEPTH)
+               build_root_table(options.root_table_bytes_);
+            if(options.share_subtrees_ && depth_ == NO_FIXED_DEPTH && table_.width_ == 0 && !inline_keys_)
+               share_subtrees();
+
+            // release the growth reserve of the build
+            shrink(headers_);
+            shrink(slots_);
+            shrink(buckets_);
+            shrink(bucket_tuples_);
+            std::vector<boost::uint32_t>().swap(columns_);
+         }
+
+         // copy of another tree for a copy of its data
+         static_radix_map_node(const node_t& other, TupleVectorT& data, const Allocator& alloc = Allocator()) 
+            : headers_(other.headers_.begin(), other.headers_.end(), alloc)
+            , slots_(other.slots_.begin(), other.slots_.end(), alloc)
+            , buckets_(other.buckets_.begin(), other.buckets_.end(), alloc)
+            , bucket_tuples_(other.bucket_tuples_.begin(), other.bucket_tuples_.end(), alloc)
+            , table_(alloc)
+            , data_(&data)     
+            , depth_(other.depth_)
+            , inline_keys_(other.inline_keys_)
+            , link_mask_(other.link_mask_)
+            , root_offset_(other.root_offset_)
+         {
+            table_ = other.table_;
+         }
+
+         // number of keys stored below a node
+         std::size_t key_count(std::size_t header = 0) const {
+            std::size_t res = 0;
+            std::vector<std::size_t> stack(1, header);
+            while(!stack.empty()) {
+               std::size_t h = stack.back();
+               stack.pop_back();
+               for(std::size_t i = headers_[h].slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  const NodeT& n = slots_[i];
+                  if(n.isLink_)
+                     stack.push_back(link_header(n));
+                  else 
+                     res += leaf_key_count(n);
+               }
+            }
+            return res;
+         }
+
+         // calculate column with maximum selectivity
+         std::size_t calc_best_index(const std::size_t* first, const std::size_t* last, const build_options& options = build_options()) const {
+            std::size_t size = last-first;
+            if(size == 1)
+               return 0;
+
+            std::size_t best_ndx = 0;
+            std::size_t min_sz = 0;
+
+            // a column splitting the sample splits all keys of the node
+            if(options.sample_threshold_ > 0 && size > options.sample_threshold_) {
+               std::vector<std::size_t> sample;
+               sample.reserve(options.sample_size_);
+               boost::uint32_t seed = static_cast<boost::uint32_t>(size);
+               for(std::size_t i = 0; i < options.sample_size_; ++i) {
+                  seed = seed*1664525u + 1013904223u;
+                  sample.push_back(first[seed % size]);
+               }
+               if(!sample.empty() && best_column(&sample[0], &sample[0]+sample.size(), options.min_fill_, best_ndx, min_sz) > 1)
+                  return best_ndx;
+            }
+
+            std::size_t max_count = best_column(first, last, options.min_fill_, best_ndx, min_sz);
+            if(max_count == 1 && best_ndx < min_sz) 
+               throw std::range_error("static_radix_map::keys are not unique!");
+
+            return best_ndx;
+         }
+
+         // returns the char count of the best column for the given keys
+         std::size_t best_column(const std::size_t* first, const std::size_t* last, double min_fill, std::size_t& best_ndx, std::size_t& min_sz) const {
+            // get length of largest string and collect the chars of all columns in 
+            // one pass over the keys, a 256 bit set per column
+            std::vector<boost::uint32_t>& chars = columns_;
+            std::fill(chars.begin(), chars.end(), 0);
+            std::size_t max_sz = 0;
+            min_sz = std::size_t(-1);
+
+            for(const std::size_t* iter = first; iter != last; ++iter) {
+               std::size_t sz = key_size(*iter);
+               if(sz > max_sz) 
+                  max_sz = sz;
+               if(sz < min_sz) 
+                  min_sz = sz;
+               if(sz*8 > chars.size())
+                  chars.resize(sz*8, 0);
+
+               const char* key = key_data(*iter);
+               for(std::size_t i = 0; i < sz; ++i) {
+                  byte_t c = static_cast<byte_t>(key[i]);
+                  chars[i*8 + (c >> 5)] |= boost::uint32_t(1) << (c & 31);
+               }
+            }
+
+            // get a column with maximum selectivity
+            // this starts from the end to avoid endless loop
+            // for prefix strings sequences. e.g. a, aa 
+            // where all columns have equal different char counts.
+            // to reduce memory consumption prefer columns with 
+            // small indexes and with small intervals of [min_val, max_val]
+            // A column is dense if its chars fill at least min_fill of the interval.
+
+            std::size_t min_slot_count = 256;
+            std::size_t max_count = 0;        
+            best_ndx = 0;
+            std::size_t dense_slot_count = 256;
+            std::size_t dense_count = 0;
+            std::size_t dense_ndx = 0;
+            for(int i = max_sz-1; i >=0; --i) {
+               std::size_t count = 0;
+               std::size_t min_char = 255;
+               std::size_t max_char = 0;
+               for(std::size_t w = 0; w < 8; ++w) {
+                  boost::uint32_t bits = chars[i*8+w];
+                  if(bits == 0)
+                     continue;
+                  count += bit_count(bits);
+                  min_char = std::min(min_char, w*32+lowest_bit(bits));
+                  max_char = w*32+highest_bit(bits);
+               }
+
+               std::size_t slot_count = max_char-min_char+1;
+               if(count > max_count || (count > 1 && count == max_count && slot_count <= min_slot_count)) {
+                  min_slot_count = slot_count;
+                  max_count = count;
+                  best_ndx = i;
+               }
+               if(count > 1 && count >= min_fill*slot_count && 
+                  (count > dense_count || (count == dense_count && slot_count <= dense_slot_count))) {
+                  dense_slot_count = slot_count;
+                  dense_count = count;
+                  dense_ndx = i;
+               }
+            }
+
+            if(min_fill > 0.0 && dense_count > 1) {
+               best_ndx = dense_ndx;
+               return dense_count;
+            }
+            return max_count;
+         }
+
+         mapped_value value(const Key& key) const {
+            std::size_t i = this->tuple(key);
+            return i == NO_TUPLE ? mapped_value() : entry_value(const_data(), i);
+         }
+
+         mapped_reference value_ref(const Key& key) {
+            std::size_t i = this->tuple(key);
+            if(i != NO_TUPLE)
+               return entry_value(*data_, i);
+            else 
+               throw std::runtime_error("static_radix_map::value: key does not exists!");
+         }
+
+         const_mapped_reference value_ref(const Key& key) const {
+            std::size_t i = this->tuple(key);
+            if(i != NO_TUPLE)
+               return entry_value(const_data(), i);
+            else 
+               throw std::runtime_error("static_radix_map::value: key does not exists!");
+         }
+
+         int count(const Key& key) const {
+            return tuple(key) != NO_TUPLE;
+         }
+
+         // fixed length types
+         std::size_t tuple(const Key& key_param, boost::mpl::true_) const {	    
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + (table_.width_ != 0 ? table_.slot(*this, key) : slot(headers_[0], key));
+            STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            while(node->isLink_) {
+               node = slots + slot(headers_[node->data_], key);
+               STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            }
+
+            if(node->isBucket_)
+               return counted(node, bucket_tuple(*node, key, sizeof(Key)));
+            if(inline_keys_) {
+               if(node->data_ == NO_TUPLE || !inline_key_equal(*node, key))
+                  return counted(node, NO_TUPLE);
+               return counted(node, node->data_ & TUPLE_MASK);
+            }
+            if(node->data_ != NO_TUPLE && entry_equal(*data_, node->data_, key, sizeof(Key)))
+               return counted(node, node->data_);
+            return counted(node, NO_TUPLE);
+         }
+
+         // fixed length types, querying only existing keys
+         std::size_t existing_tuple(const Key& key_param, boost::mpl::true_) const {	    
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + (table_.width_ != 0 ? table_.existing_slot(*this, key) : existing_slot(headers_[0], key));
+            STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            while(node->isLink_) {
+               node = slots + existing_slot(headers_[node->data_], key);
+               STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            }
+
+            return counted(node, leaf_tuple(*node, key, sizeof(Key)));
+         }
+
+         // fixed length types, querying only existing keys of a fixed depth tree
+         std::size_t fixed_depth_tuple(const Key& key_param, boost::mpl::true_) const {	    
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + existing_slot(headers_[0], key);
+
+            // the trip count is equal for all keys, thus the branches are always predicted
+            std::size_t depth = depth_;
+            for(; depth >= 4; depth -= 4) {
+               node = slots + existing_slot(headers_[node->data_], key);
+               node = slots + existing_slot(headers_[node->data_], key);
+               node = slots + existing_slot(headers_[node->data_], key);
+               node = slots + existing_slot(headers_[node->data_], key);
+            }
+            switch(depth) {
+               case 3: node = slots + existing_slot(headers_[node->data_], key); // fall through
+               case 2: node = slots + existing_slot(headers_[node->data_], key); // fall through
+               case 1: node = slots + existing_slot(headers_[node->data_], key); // fall through
+               default: break;
+            }
+
+            STATIC_RADIX_MAP_COUNT(LEVELS, depth_+1);
+            return counted(node, leaf_tuple(*node, key, sizeof(Key)));
+         }
+
+         // variable length types, querying only existing keys of a fixed depth tree
+         std::size_t fixed_depth_tuple(const Key& key_param, boost::mpl::false_) const {	    
+            std::size_t len = to_size(key_param);
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + variable_slot(headers_[0], key, len);
+
+            std::size_t depth = depth_;
+            for(; depth >= 4; depth -= 4) {
+               node = slots + variable_slot(headers_[node->data_], key, len);
+               node = slots + variable_slot(headers_[node->data_], key, len);
+               node = slots + variable_slot(headers_[node->data_], key, len);
+               node = slots + variable_slot(headers_[node->data_], key, len);
+            }
+            switch(depth) {
+               case 3: node = slots + variable_slot(headers_[node->data_], key, len); // fall through
+               case 2: node = slots + variable_slot(headers_[node->data_], key, len); // fall through
+               case 1: node = slots + variable_slot(headers_[node->data_], key, len); // fall through
+               default: break;
+            }
+
+            STATIC_RADIX_MAP_COUNT(LEVELS, depth_+1);
+            return counted(node, leaf_tuple(*node, key, len));
+         }
+
+         // variable length types like std::string or const char*
+         std::size_t tuple(const Key& key_param, boost::mpl::false_) const {	    
+            std::size_t len = to_size(key_param);
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + (table_.width_ != 0 && table_.max_ndx_ < len ? table_.slot(*this, key) : slot(headers_[0], key, len));
+            STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            while(node->isLink_) {
+               node = slots + slot(headers_[node->data_], key, len);
+               STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            }
+
+            if(node->isBucket_)
+               return counted(node, bucket_tuple(*node, key, len));
+            if(node->data_ != NO_TUPLE && key_equal(node->data_, key, len))
+               return counted(node, node->data_);
+            return counted(node, NO_TUPLE);
+         }
+
+         // variable length types like std::string or const char*, query existing keys
+         std::size_t existing_tuple(const Key& key_param, boost::mpl::false_) const {	    
+            std::size_t len = to_size(key_param);
+            const char* key = to_const_char(key_param);
+            const NodeT* slots = &slots_[0];
+
+            const NodeT* node = slots + (table_.width_ != 0 && table_.max_ndx_ < len ? table_.existing_slot(*this, key) : existing_slot(headers_[0], key, len));
+            STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            while(node->isLink_) {
+               node = slots + existing_slot(headers_[node->data_], key, len);
+               STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            }
+
+            return counted(node, leaf_tuple(*node, key, len));
+         }
+
+         // lookups in a tree with shared subtrees, the tuples of the leaves are 
+         // relative to the sum of the offsets along the path
+         std::size_t shared_tuple(const Key& key_param, boost::mpl::true_) const {
+            return shared_lookup(to_const_char(key_param), sizeof(Key));
+         }
+
+         std::size_t shared_tuple(const Key& key_param, boost::mpl::false_) const {
+            return shared_lookup(to_const_char(key_param), to_size(key_param));
+         }
+
+         std::size_t shared_lookup(const char* key, std::size_t len) const {
+            const NodeT* slots = &slots_[0];
+            std::size_t offset = root_offset_;
+
+            const NodeT* node = slots + slot(headers_[0], key, len);
+            STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            while(node->isLink_) {
+               offset += node->data_ >> LINK_BITS;
+               node = slots + slot(headers_[node->data_ & LINK_MASK], key, len);
+               STATIC_RADIX_MAP_COUNT(LEVELS, 1);
+            }
+
+            // a shared bucket is sorted by the keys of its first subtree only, 
+            // the keys at another offset need not be in the same order
+            if(node->isBucket_) {
+               const BucketT& bucket = buckets_[node->data_];
+               for(std::size_t i = bucket.first_, i_end = i+bucket.size_; i < i_end; ++i) {
+                  if(key_equal(bucket_tuples_[i]+offset, key, len))
+                     return counted(node, bucket_tuples_[i]+offset);
+               }
+               return counted(node, NO_TUPLE);
+            }
+            if(node->data_ != NO_TUPLE && key_equal(node->data_+offset, key, len))
+               return counted(node, node->data_+offset);
+            return counted(node, NO_TUPLE);
+         }
+
+         // position of the key in data, NO_TUPLE for absent keys
+         std::size_t tuple(const Key& key_param) const {	   
+            typedef typename boost::mpl::end<variable_length_types>::type end_type;
+            STATIC_RADIX_MAP_COUNT(LOOKUPS, 1);
+            if(link_mask_ != NO_TUPLE)
+               return 
+                  shared_tuple(
+                     key_param, 
+                     typename boost::is_same<
+                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
+                     >::type()
+                  );
+            else if(queryOnlyExistingKeys && depth_ != NO_FIXED_DEPTH) 
+               return 
+                  fixed_depth_tuple(
+                     key_param, 
+                     typename boost::is_same<
+                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
+                     >::type()
+                  );
+            else if(queryOnlyExistingKeys) 
+               return 
+                  existing_tuple(
+                     key_param, 
+                     typename boost::is_same<
+                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
+                     >::type()
+                  );
+            else
+               return 
+                  tuple(
+                     key_param, 
+                     typename boost::is_same<
+                        typename boost::mpl::find<variable_length_types, Key>::type, end_type
+                     >::type()
+                  );
+         }
+
+         // tuples in the memory order of their leaves, trees without shared subtrees
+         std::vector<std::size_t> leaf_order() const {
+            std::vector<std::size_t> res;
+            res.reserve(data_->size());
+            for(std::size_t i = 1; i < slots_.size(); ++i) {
+               const NodeT& n = slots_[i];
+               if(n.isBucket_) {
+                  const BucketT& bucket = buckets_[n.data_];
+                  res.insert(res.end(), &bucket_tuples_[bucket.first_], &bucket_tuples_[bucket.first_]+bucket.size_);
+               }
+               else if(is_tuple(n))
+                  res.push_back(leaf_index(n));
+            }
+            return res;
+         }
+
+         // the tree refers to its data by index, e.g. after swapping maps
+         void rebind(TupleVectorT& data) {
+            data_ = &data;
+         }
+
+         std::size_t used_mem() const {
+            return 
+               sizeof(*this) 
+               + headers_.capacity()*sizeof(NodeHeaderT) 
+               + slots_.capacity()*sizeof(NodeT)
+               + buckets_.capacity()*sizeof(BucketT)
+               + bucket_tuples_.capacity()*sizeof(std::size_t)
+               + table_.slots_.capacity()*sizeof(std::size_t);
+         }
+
+         // the tree part of the map's memory_breakdown()
+         void add_mem(memory_usage& usage) const {
+            usage.index += sizeof(*this);
+            add_vector(headers_, usage.node_headers, usage.heap_blocks);
+            add_vector(slots_, usage.slots, usage.heap_blocks);
+            add_vector(table_.slots_, usage.slots, usage.heap_blocks);
+            add_vector(buckets_, usage.buckets, usage.heap_blocks);
+            add_vector(bucket_tuples_, usage.buckets, usage.heap_blocks);
+         }
+
+         static inline std::size_t slot_size(std::size_t min_slot, std::size_t max_slot) {	   
+            return (max_slot >= min_slot) ? max_slot-min_slot+2 : 0;
+         }
+
+         static inline std::size_t bit_count(boost::uint32_t x) {
+            x = x - ((x >> 1) & 0x55555555u);
+            x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+            return (((x + (x >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+         }
+
+         static inline std::size_t lowest_bit(boost::uint32_t x) {
+            std::size_t res = 0;
+            for(; (x & 1) == 0; x >>= 1)
+               ++res;
+            return res;
+         }
+
+         static inline std::size_t highest_bit(boost::uint32_t x) {
+            std::size_t res = 0;
+            while(x >>= 1)
+               ++res;
+            return res;
+         }
+
+         // maximum number of links followed to reach a key
+         std::size_t max_path_length() const {
+            std::size_t res = 0;
+            std::vector<std::pair<std::size_t, std::size_t> > stack(1, std::make_pair(std::size_t(0), std::size_t(0)));
+            while(!stack.empty()) {
+               std::size_t header = stack.back().first;
+               std::size_t deep = stack.back().second;
+               stack.pop_back();
+
+               res = std::max(res, deep);
+               for(std::size_t i = headers_[header].slots_, i_end = i+header_slot_size(header); i < i_end; ++i) {
+                  if(slots_[i].isLink_)
+                     stack.push_back(std::pair<std::size_t, std::size_t>(link_header(slots_[i]), deep+1));
+               }
+            }
+            return res;
+         }
+
+         double average_path_length() const {
+            // sum of path lengths over all keys
+            std::vector<std::pair<std::size_t, std::size_t> > stack(1, std::make_pair(std::size_t(0), std::size_t(0)));
+            std::size_t res = 0;
+
+            while(!stack.empty()) {
+               std::size_t header = stack.back().first;
+               std::size_t deep = stack.back().second;
+               stack.pop_back();
+
+               for(std::size_t i = headers_[header].slots_, i_end = i+header_slot_size(header); i < i_end; ++i) {
+                  const NodeT& n = slots_[i];
+                  if(n.isLink_)
+                     stack.push_back(std::pair<std::size_t, std::size_t>(link_header(n), deep+1));
+                  else 
+                     res += deep*leaf_key_count(n);
+               }
+            }
+
+            return data_->empty() ? 0.0 : (res*1.0)/data_->size();
+         }
+
+         // the tree part of the map's stats()
+         tree_stats stats() const {
+            tree_stats res;
+            res.nodes = headers_.size();
+            res.slots = slots_.size();
+            res.buckets = buckets_.size();
+            for(std::size_t i = 0; i < buckets_.size(); ++i)
+               res.max_bucket_size = std::max<std::size_t>(res.max_bucket_size, buckets_[i].size_);
+
+            for(std::size_t h = 0; h < headers_.size(); ++h) {
+               std::size_t fanout = 0;
+               for(std::size_t i = headers_[h].slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  if(slots_[i].isLink_ || leaf_key_count(slots_[i]) > 0)
+                     ++fanout;
+               }
+               res.used_slots += fanout;
+               if(res.nodes_by_fanout.size() <= fanout)
+                  res.nodes_by_fanout.resize(fanout+1);
+               ++res.nodes_by_fanout[fanout];
+               if(header_slot_size(h) > 0) {
+                  std::size_t column = headers_[h].ndx_;
+                  if(res.nodes_by_column.size() <= column)
+                     res.nodes_by_column.resize(column+1);
+                  ++res.nodes_by_column[column];
+               }
+            }
+
+            std::size_t depth_sum = 0;
+            std::vector<std::pair<std::size_t, std::size_t> > stack(1, std::make_pair(std::size_t(0), std::size_t(0)));
+            while(!stack.empty()) {
+               std::size_t header = stack.back().first;
+               std::size_t deep = stack.back().second;
+               stack.pop_back();
+
+               res.max_depth = std::max(res.max_depth, deep);
+               for(std::size_t i = headers_[header].slots_, i_end = i+header_slot_size(header); i < i_end; ++i) {
+                  const NodeT& n = slots_[i];
+                  if(n.isLink_) {
+                     stack.push_back(std::pair<std::size_t, std::size_t>(link_header(n), deep+1));
+                  }
+                  else if(leaf_key_count(n) > 0) {
+                     if(res.keys_by_depth.size() <= deep)
+                        res.keys_by_depth.resize(deep+1);
+                     res.keys_by_depth[deep] += leaf_key_count(n);
+                     res.keys += leaf_key_count(n);
+                     depth_sum += deep*leaf_key_count(n);
+                  }
+               }
+            }
+            res.average_depth = res.keys == 0 ? 0.0 : (depth_sum*1.0)/res.keys;
+            return res;
+         }
+
+         // the nodes visited by a verifying lookup of the key. The root table and 
+         // the unchecked slots of maps querying only existing keys are not used.
+         lookup_trace explain(const Key& key_param) const {
+            typedef typename boost::mpl::end<variable_length_types>::type end_type;
+            return explain(
+               to_const_char(key_param), 
+               key_length(
+                  key_param, 
+                  typename boost::is_same<
+                     typename boost::mpl::find<variable_length_types, Key>::type, end_type
+                  >::type()
+               )
+            );
+         }
+
+         lookup_trace explain(const char* key, std::size_t len) const {
+            lookup_trace res;
+            res.position = data_->size();
+            std::size_t offset = link_mask_ != NO_TUPLE ? root_offset_ : 0;
+            const NodeT* node = 0;
+            for(std::size_t header = 0; ; ) {
+               const NodeHeaderT& h = headers_[header];
+               std::size_t i = h.ndx_ < len ? slot(h, key) : h.slots_+h.max_slot_-h.min_slot_+1;
+               lookup_step step;
+               step.node = header;
+               step.column = h.ndx_;
+               step.byte = h.ndx_ < len ? static_cast<byte_t>(key[h.ndx_]) : -1;
+               step.min_slot = h.min_slot_;
+               step.max_slot = h.max_slot_;
+               step.slot = i == 0 ? empty_slot : (h.ndx_ >= len ? terminator_slot : byte_slot);
+               res.path.push_back(step);
+
+               node = &slots_[i];
+               if(!node->isLink_)
+                  break;
+               if(link_mask_ != NO_TUPLE)
+                  offset += node->data_ >> LINK_BITS;
+               header = link_header(*node);
+            }
+
+            if(node->isBucket_) {
+               const BucketT& bucket = buckets_[node->data_];
+               res.bucket_size = bucket.size_;
+               res.result = key_mismatch;
+               for(std::size_t i = bucket.first_, i_end = i+bucket.size_; i < i_end; ++i) {
+                  if(key_equal(bucket_tuples_[i]+offset, key, len)) {
+                     res.result = key_found;
+                     res.position = bucket_tuples_[i]+offset;
+                     break;
+                  }
+               }
+            }
+            else if(node->data_ != NO_TUPLE) {
+               std::size_t tuple = leaf_index(*node)+offset;
+               if(!VerifiesKeysT<TupleVectorT>::value)
+                  res.result = key_unverified;
+               else if(inline_keys_)
+                  res.result = inline_key_equal(*node, key) ? key_found : key_mismatch;
+               else
+                  res.result = key_equal(tuple, key, len) ? key_found : key_mismatch;
+               if(res.found())
+                  res.position = tuple;
+            }
+            return res;
+         }
+
+         // Graphviz digraph of the nodes. Edges are labelled by the key byte, $ is the 
+         // terminator slot. Leaves show their entry position, relative to the path for 
+         // shared subtrees, buckets their size.
+         void write_dot(std::ostream& os) const {
+            os << "digraph static_radix_map {\n";
+            for(std::size_t h = 0; h < headers_.size(); ++h) {
+               const NodeHeaderT& n = headers_[h];
+               os << "  n" << h << " [label=\"col " << n.ndx_ << " [" << std::size_t(n.min_slot_) << ".." << std::size_t(n.max_slot_) << "]\"];\n";
+               for(std::size_t i = n.slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  const NodeT& slot = slots_[i];
+                  if(!slot.isLink_ && leaf_key_count(slot) == 0)
+                     continue;
+                  std::size_t byte = n.min_slot_+(i-n.slots_);
+                  if(slot.isLink_) 
+                     os << "  n" << h << " -> n" << link_header(slot);
+                  else if(slot.isBucket_)
+                     os << "  s" << i << " [shape=box,label=\"bucket " << buckets_[slot.data_].size_ << "\"];\n  n" << h << " -> s" << i;
+                  else
+                     os << "  s" << i << " [shape=plaintext,label=\"" << leaf_index(slot) << "\"];\n  n" << h << " -> s" << i;
+                  if(i+1 == i_end)
+                     os << " [label=\"$\"];\n";
+                  else
+                     os << " [label=\"" << byte << "\"];\n";
+               }
+            }
+            os << "}\n";
+         }
+
+         // the nodes as JSON: column, byte interval and the used slots of each node.
+         // A slot has its byte (-1 for the terminator) and a link, entry or bucket.
+         void write_json(std::ostream& os) const {
+            os << "{\"nodes\":[";
+            for(std::size_t h = 0; h < headers_.size(); ++h) {
+               const NodeHeaderT& n = headers_[h];
+               os << (h == 0 ? "" : ",") << "\n{\"id\":" << h << ",\"column\":" << n.ndx_ 
+                  << ",\"min_slot\":" << std::size_t(n.min_slot_) << ",\"max_slot\":" << std::size_t(n.max_slot_) << ",\"slots\":[";
+               bool first = true;
+               for(std::size_t i = n.slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  const NodeT& slot = slots_[i];
+                  if(!slot.isLink_ && leaf_key_count(slot) == 0)
+                     continue;
+                  os << (first ? "" : ",") << "{\"byte\":";
+                  if(i+1 == i_end)
+                     os << -1;
+                  else
+                     os << n.min_slot_+(i-n.slots_);
+                  if(slot.isLink_)
+                     os << ",\"link\":" << link_header(slot) << "}";
+                  else if(slot.isBucket_) {
+                     const BucketT& bucket = buckets_[slot.data_];
+                     os << ",\"bucket\":[";
+                     for(std::size_t j = 0; j < bucket.size_; ++j)
+                        os << (j == 0 ? "" : ",") << bucket_tuples_[bucket.first_+j];
+                     os << "]}";
+                  }
+                  else
+                     os << ",\"entry\":" << leaf_index(slot) << "}";
+                  first = false;
+               }
+               os << "]}";
+            }
+            os << "\n]}\n";
+         }
+
+
+      private:
+
+         // a slot of a node: a link to a node header, a tuple, or a bucket of tuples.
+         // The flags share the word with the index.
+         struct NodeT {
+            NodeT() 
+               : isLink_(false)
+               , isBucket_(false)
+               , data_(NO_TUPLE)
+            {}
+
+            Index isLink_ : 1;
+            Index isBucket_ : 1;
+            Index data_ : DATA_BITS;
+         };
+
+         // 16 bytes for std::size_t, 8 for boost::uint32_t and 6 for boost::uint16_t
+         struct NodeHeaderT {
+            Index slots_;                // position of the first slot
+            ColumnT ndx_;                // column
+            byte_t min_slot_;
+            byte_t max_slot_;
+         };
+
+         struct BucketT {
+            std::size_t first_;          // position in bucket_tuples_
+            std::size_t size_;
+         };
+
+         // open range of the index array to be built into a node for a slot
+         struct TaskT {
+            std::size_t slot_;
+            std::size_t* first_;
+            std::size_t* last_;
+            std::size_t depth_;
+         };
+
+         // a key searched in a bucket
+         struct SearchKeyT {
+            const char* key_;
+            std::size_t len_;
+         };
+
+         // key order of tuple indexes, by length first
+         struct KeyLess {
+            explicit KeyLess(const node_t& tree) 
+               : tree_(&tree) 
+            {}
+
+            bool operator()(std::size_t a, std::size_t b) const {
+               std::size_t a_size = tree_->key_size(a);
+               std::size_t b_size = tree_->key_size(b);
+               if(a_size != b_size)
+                  return a_size < b_size;
+               return std::memcmp(tree_->key_data(a), tree_->key_data(b), a_size) < 0;
+            }
+
+            bool operator()(std::size_t a, const SearchKeyT& b) const {
+               std::size_t a_size = tree_->key_size(a);
+               if(a_size != b.len_)
+                  return a_size < b.len_;
+               return std::memcmp(tree_->key_data(a), b.key_, a_size) < 0;
+            }
+
+            const node_t* tree_;
+         };
+
+         // header order by descending weight
+         struct WeightGreater {
+            explicit WeightGreater(const std::vector<std::size_t>& weights) 
+               : weights_(&weights) 
+            {}
+
+            bool operator()(std::size_t a, std::size_t b) const {
+               return (*weights_)[a] > (*weights_)[b];
+            }
+
+            const std::vector<std::size_t>* weights_;
+         };
+
+         typedef std::vector<NodeHeaderT, typename RebindT<Allocator, NodeHeaderT>::type> HeaderVectorT;
+         typedef std::vector<NodeT, typename RebindT<Allocator, NodeT>::type> SlotVectorT;
+         typedef std::vector<BucketT, typename RebindT<Allocator, BucketT>::type> BucketVectorT;
+         typedef std::vector<std::size_t, typename RebindT<Allocator, std::size_t>::type> IndexVectorT;
+         typedef std::vector<char, typename RebindT<Allocator, char>::type> CharVectorT;
+
+         // direct table over the bytes of the root column and a second column, 
+         // the entries are slot positions
+         struct RootTableT {
+            explicit RootTableT(const Allocator& alloc) 
+               : ndx_(0)
+               , max_ndx_(0)
+               , min_slot_(0)
+               , width_(0)
+               , slots_(alloc)
+            {}
+
+            std::size_t ndx_;        // second column
+            std::size_t max_ndx_;    // keys must be longer than this to use the table
+            std::size_t min_slot_;   // smallest byte of the second column
+            std::size_t width_;      // byte interval of the second column, 0 without table
+            IndexVectorT slots_;
+
+            // a key byte out of the second interval continues at the root slot
+            std::size_t slot(const node_t& tree, const char* key) const {
+               const NodeHeaderT& root = tree.headers_[0];
+               std::size_t row = static_cast<std::size_t>(static_cast<byte_t>(key[root.ndx_])) - root.min_slot_;
+               if(row > static_cast<std::size_t>(root.max_slot_ - root.min_slot_))
+                  return 0;
+               std::size_t col = static_cast<std::size_t>(static_cast<byte_t>(key[ndx_])) - min_slot_;
+               return col < width_ ? slots_[row*width_+col] : root.slots_+row;
+            }
+
+            std::size_t existing_slot(const node_t& tree, const char* key) const {
+               const NodeHeaderT& root = tree.headers_[0];
+               std::size_t row = static_cast<std::size_t>(static_cast<byte_t>(key[root.ndx_])) - root.min_slot_;
+               std::size_t col = static_cast<std::size_t>(static_cast<byte_t>(key[ndx_])) - min_slot_;
+               return col < width_ ? slots_[row*width_+col] : root.slots_+row;
+            }
+         };
+
+         // child of a root slot which is covered by the second table column
+         const NodeHeaderT* table_child(const NodeT& n, std::size_t ndx) const {
+            return (n.isLink_ && headers_[n.data_].ndx_ == ndx) ? &headers_[n.data_] : 0;
+         }
+
+         // slot positions of a key in a node, 0 is the empty slot
+         static inline std::size_t slot(const NodeHeaderT& n, const char* key) {
+            std::size_t slot = static_cast<byte_t>(key[n.ndx_]);
+            return (slot >= n.min_slot_ && slot <= n.max_slot_) ? n.slots_+slot-n.min_slot_ : 0;
+         }
+
+         static inline std::size_t slot(const NodeHeaderT& n, const char* key, std::size_t len) {
+            if(n.ndx_ >= len) {
+               STATIC_RADIX_MAP_COUNT(TERMINATOR_SLOTS, 1);
+               return n.slots_+n.max_slot_-n.min_slot_+1;
+            }
+            std::size_t slot = static_cast<byte_t>(key[n.ndx_]);
+            return (slot >= n.min_slot_ && slot <= n.max_slot_) ? n.slots_+slot-n.min_slot_ : 0;
+         }
+
+         static inline std::size_t existing_slot(const NodeHeaderT& n, const char* key) {
+            return n.slots_+static_cast<byte_t>(key[n.ndx_])-n.min_slot_;
+         }
+
+         static inline std::size_t existing_slot(const NodeHeaderT& n, const char* key, std::size_t len) {
+            if(n.ndx_ >= len) {
+               STATIC_RADIX_MAP_COUNT(TERMINATOR_SLOTS, 1);
+               return n.slots_+n.max_slot_-n.min_slot_+1;
+            }
+            return n.slots_+static_cast<byte_t>(key[n.ndx_])-n.min_slot_;
+         }
+
+         // slot selection without branches, keys not longer than ndx_ use the terminator 
+         // slot. key[0] is always readable because keys are null terminated.
+         static inline std::size_t variable_slot(const NodeHeaderT& n, const char* key, std::size_t len) {
+            bool inside = n.ndx_ < len;
+            STATIC_RADIX_MAP_COUNT(TERMINATOR_SLOTS, !inside);
+            std::size_t slot = static_cast<byte_t>(key[inside ? n.ndx_ : 0]);
+            return n.slots_ + (inside ? slot-n.min_slot_ : n.max_slot_-n.min_slot_+1);
+         }
+
+         // the result of a lookup ending at a leaf, classified by the lookup counters
+         std::size_t counted(const NodeT* node, std::size_t res) const {
+#ifdef STATIC_RADIX_MAP_LOOKUP_COUNTERS
+            if(res != NO_TUPLE)
+               STATIC_RADIX_MAP_COUNT(HITS, 1);
+            else if(node == &slots_[0])
+               STATIC_RADIX_MAP_COUNT(RANGE_MISSES, 1);
+            else if(!node->isBucket_ && node->data_ == NO_TUPLE)
+               STATIC_RADIX_MAP_COUNT(EMPTY_MISSES, 1);
+            else
+               STATIC_RADIX_MAP_COUNT(COMPARE_MISSES, 1);
+#else
+            (void)node;
+#endif
+            return res;
+         }
+
+         // tuple of a leaf reached by an existing key
+         std::size_t leaf_tuple(const NodeT& n, const char* key, std::size_t len) const {
+            return n.isBucket_ ? bucket_tuple(n, key, len) : leaf_index(n);
+         }
+
+         // binary search in the bucket sorted by create_bucket()
+         std::size_t bucket_tuple(const NodeT& n, const char* key, std::size_t len) const {
+            const BucketT& bucket = buckets_[n.data_];
+            const std::size_t* first = &bucket_tuples_[0]+bucket.first_;
+            const std::size_t* last = first+bucket.size_;
+            SearchKeyT search = { key, len };
+            const std::size_t* iter = std::lower_bound(first, last, search, KeyLess(*this));
+            if(iter != last && key_equal(*iter, key, len))
+               return *iter;
+            return NO_TUPLE;
+         }
+
+         // compares a key with the key of a tuple
+         bool key_equal(std::size_t tuple, const char* key, std::size_t len) const {
+            return entry_equal(*data_, tuple, key, len);
+         }
+
+         static inline std::size_t key_length(const Key&, boost::mpl::true_) {
+            return sizeof(Key);
+         }
+
+         static inline std::size_t key_length(const Key& key, boost::mpl::false_) {
+            return to_size(key);
+         }
+
+         // header of a link slot
+         std::size_t link_header(const NodeT& n) const {
+            return n.data_ & link_mask_;
+         }
+
+         // tuple index of a leaf slot
+         std::size_t leaf_index(const NodeT& n) const {
+            return inline_keys_ ? n.data_ & TUPLE_MASK : n.data_;
+         }
+
+         // slot data of a leaf
+         std::size_t leaf_data(std::size_t tuple) const {
+            return inline_keys_ ? tuple | inline_key(key_data(tuple)) << TUPLE_BITS : tuple;
+         }
+
+         // compares the key bits of a leaf, the narrow bitfield of small Index types promotes to int
+         static inline bool inline_key_equal(const NodeT& n, const char* key) {
+            return static_cast<std::size_t>(n.data_ >> TUPLE_BITS) == inline_key(key);
+         }
+
+         // the key bytes as number, independent of the byte order
+         static inline std::size_t inline_key(const char* key) {
+            std::size_t res = 0;
+            for(std::size_t i = 0; i < INLINE_KEY_BITS/8; ++i)
+               res |= std::size_t(static_cast<byte_t>(key[i])) << (8*i);
+            return res;
+         }
+
+         bool is_tuple(const NodeT& n) const {
+            return !n.isLink_ && !n.isBucket_ && n.data_ != NO_TUPLE;
+         }
+
+         std::size_t leaf_key_count(const NodeT& n) const {
+            if(n.isBucket_)
+               return buckets_[n.data_].size_;
+            return n.data_ != NO_TUPLE ? 1 : 0;
+         }
+
+         std::size_t header_slot_size(std::size_t header) const {
+            return slot_size(headers_[header].min_slot_, headers_[header].max_slot_);
+         }
+
+         // Builds the tree without recursion. All keys are kept in one index array,
+         // each node radix partitions its subrange in place by the byte of its column.
+         void initialize(const std::vector<std::size_t>& nodeIndexes, const build_options& options) {
+            // tuples 0..NO_TUPLE-1, NO_TUPLE itself marks empty slots
+            if(data_->size() > NO_TUPLE)
+               throw std::range_error("static_radix_map::too many keys for the index type!");
+
+            std::vector<std::size_t> order(nodeIndexes);
+            order.push_back(0); // keeps &order[0] valid for empty maps
+            std::vector<TaskT> tasks;
+
+            slots_.push_back(NodeT()); // slot 0 is the empty slot for out of range bytes
+            headers_.reserve(nodeIndexes.size()/2+1);
+            slots_.reserve(nodeIndexes.size()*2+1);
+
+            create_node(&order[0], &order[0]+nodeIndexes.size(), 0, options, tasks);
+            while(!tasks.empty()) {
+               TaskT task = tasks.back();
+               tasks.pop_back();
+               std::size_t link = create_node(task.first_, task.last_, task.depth_, options, tasks);
+               slots_[task.slot_].isLink_ = true;
+               slots_[task.slot_].data_ = link;
+            }
+         }
+
+         // creates the node for the keys [first, last) and returns its header index.
+         // Slots with more than one key are queued as tasks.
+         std::size_t create_node(std::size_t* first, std::size_t* last, std::size_t depth, const build_options& options, std::vector<TaskT>& tasks) {
+            std::size_t size = last-first;
+            std::size_t ndx = size == 0 ? 0 : this->calc_best_index(first, last, options);
+
+            // bucket MAX_SLOTS-1 takes all keys with length less than selected index
+            std::size_t counts[MAX_SLOTS] = { 0 };
+            for(std::size_t i = 0; i < size; ++i) 
+               ++counts[column_bucket(first[i], ndx)];
+
+            std::size_t min_slot = 255;
+            std::size_t max_slot = 0;
+            for(std::size_t b = 0; b < MAX_SLOTS-1; ++b) {
+               if(counts[b] != 0) {
+                  min_slot = std::min(min_slot, b);
+                  max_slot = std::max(max_slot, b);
+               }
+            }
+            if(min_slot > max_slot) // all keys are shorter than the selected index
+               min_slot = max_slot = 0;
+
+            // american flag sort: swap every key into its bucket
+            std::size_t starts[MAX_SLOTS];
+            std::size_t next[MAX_SLOTS];
+            for(std::size_t b = 0, sum = 0; b < MAX_SLOTS; ++b) {
+               starts[b] = next[b] = sum;
+               sum += counts[b];
+            }
+            for(std::size_t b = 0; b < MAX_SLOTS; ++b) {
+               std::size_t b_end = starts[b]+counts[b];
+               while(next[b] < b_end) {
+                  std::size_t target = column_bucket(first[next[b]], ndx);
+                  if(target == b)
+                     ++next[b];
+                  else
+                     std::swap(first[next[b]], first[next[target]++]);
+               }
+            }
+
+            check_node_limits(ndx);
+            std::size_t header = headers_.size();
+            NodeHeaderT h;
+            h.ndx_ = ndx;
+            h.slots_ = slots_.size();
+            h.min_slot_ = static_cast<byte_t>(min_slot);
+            h.max_slot_ = static_cast<byte_t>(max_slot);
+            headers_.push_back(h);
+            slots_.resize(slots_.size()+slot_size(min_slot, max_slot));
+
+            // queued in reverse to build the children in slot order
+            for(std::size_t b = MAX_SLOTS; b-- > 0;) {
+               if(counts[b] == 0)
+                  continue;
+
+               std::size_t slot = h.slots_ + (b == MAX_SLOTS-1 ? max_slot-min_slot+1 : b-min_slot);
+               std::size_t* b_first = first+starts[b];
+               std::size_t* b_last = b_first+counts[b];
+               if(counts[b] == 1) 
+                  slots_[slot].data_ = leaf_data(*b_first);
+               else if(depth >= options.max_depth_) {
+                  slots_[slot].isBucket_ = true;
+                  slots_[slot].data_ = create_bucket(b_first, b_last);
+               }
+               else {
+                  TaskT task;
+                  task.slot_ = slot;
+                  task.first_ = b_first;
+                  task.last_ = b_last;
+                  task.depth_ = depth+1;
+                  tasks.push_back(task);
+               }
+            }
+            return header;
+         }
+
+         // the column and the first slot of a new node and its header index must fit the header
+         void check_node_limits(std::size_t ndx) const {
+            if(ndx > MAX_COLUMN || slots_.size() > MAX_INDEX || headers_.size() > NO_TUPLE)
+               throw std::range_error("static_radix_map::too many nodes for the index type!");
+         }
+
+         // first slot of a node appended by a relayout, it must fit the header
+         static std::size_t next_slot(const SlotVectorT& slots) {
+            if(slots.size() > MAX_INDEX)
+               throw std::range_error("static_radix_map::too many nodes for the index type!");
+            return slots.size();
+         }
+
+         // bucket of a key in the partition by column ndx
+         std::size_t column_bucket(std::size_t tuple, std::size_t ndx) const {
+            return key_size(tuple) > ndx ? static_cast<byte_t>(key_data(tuple)[ndx]) : MAX_SLOTS-1;
+         }
+
+         // keys below the depth bound, sorted for the binary search of bucket_tuple()
+         std::size_t create_bucket(std::size_t* first, std::size_t* last) {
+            KeyLess less(*this);
+            std::sort(first, last, less);
+            for(std::size_t* iter = first+1; iter != last; ++iter) {
+               if(!less(*(iter-1), *iter))
+                  throw std::range_error("static_radix_map::keys are not unique!");
+            }
+
+            BucketT bucket;
+            bucket.first_ = bucket_tuples_.size();
+            bucket.size_ = last-first;
+            bucket_tuples_.insert(bucket_tuples_.end(), first, last);
+            buckets_.push_back(bucket);
+            return buckets_.size()-1;
+         }
+
+         // Replace all leaves above the given depth by chains of single key nodes. 
+         // A single key node has exactly one used slot for its key.
+         void pad_leaves(std::size_t target) {
+            std::vector<std::pair<std::size_t, std::size_t> > stack(1, std::make_pair(std::size_t(0), std::size_t(0)));
+
+            while(!stack.empty()) {
+               std::size_t header = stack.back().first;
+               std::size_t depth = stack.back().second;
+               stack.pop_back();
+
+               for(std::size_t i = headers_[header].slots_, i_end = i+header_slot_size(header); i < i_end; ++i) {
+                  if(is_tuple(slots_[i]) && depth < target) {
+                     std::size_t single = create_single_node(leaf_index(slots_[i]));
+                     slots_[i].isLink_ = true;
+                     slots_[i].data_ = single;
+                  }
+                  if(slots_[i].isLink_)
+                     stack.push_back(std::pair<std::size_t, std::size_t>(static_cast<std::size_t>(slots_[i].data_), depth+1));
+               }
+            }
+         }
+
+         // node with the key in its first slot, or in the terminator slot for empty keys
+         std::size_t create_single_node(std::size_t tuple) {
+            std::size_t len = key_size(tuple);
+
+            check_node_limits(0);
+            NodeHeaderT h;
+            h.ndx_ = 0;
+            h.slots_ = slots_.size();
+            h.min_slot_ = h.max_slot_ = len > 0 ? static_cast<byte_t>(key_data(tuple)[0]) : 0;
+            headers_.push_back(h);
+            slots_.resize(slots_.size()+slot_size(h.min_slot_, h.max_slot_));
+            slots_[h.slots_ + (len > 0 ? 0 : 1)].data_ = leaf_data(tuple);
+            return headers_.size()-1;
+         }
+
+         // Merges structurally equal subtrees bottom up. The leaves of a node store 
+         // their tuple relative to the smallest tuple below the node (its base), a link 
+         // stores the difference between the bases of child and parent. Children 
+         // have larger header indexes than their parents.
+         void share_subtrees() {
+            std::size_t count = headers_.size();
+            if(data_->empty() || count >= LINK_MASK || data_->size() > (NO_TUPLE >> LINK_BITS))
+               return;
+
+            std::vector<std::size_t> base(count);
+            std::vector<std::size_t> canon(count);
+            std::map<std::vector<std::size_t>, std::size_t> shapes;
+            std::vector<std::size_t> shape;
+            for(std::size_t h = count; h-- > 0;) {
+               const NodeHeaderT& n = headers_[h];
+               std::size_t i_first = n.slots_;
+               std::size_t i_end = i_first+header_slot_size(h);
+
+               std::size_t b = NO_TUPLE;
+               for(std::size_t i = i_first; i < i_end; ++i) {
+                  const NodeT& s = slots_[i];
+                  if(s.isLink_)
+                     b = std::min<std::size_t>(b, base[s.data_]);
+                  else if(s.isBucket_) {
+                     const BucketT& bucket = buckets_[s.data_];
+                     b = std::min(b, *std::min_element(&bucket_tuples_[bucket.first_], &bucket_tuples_[bucket.first_]+bucket.size_));
+                  }
+                  else if(s.data_ != NO_TUPLE)
+                     b = std::min<std::size_t>(b, s.data_);
+               }
+               base[h] = b;
+
+               shape.clear();
+               shape.push_back(n.ndx_);
+               shape.push_back(n.min_slot_);
+               shape.push_back(n.max_slot_);
+               for(std::size_t i = i_first; i < i_end; ++i) {
+                  const NodeT& s = slots_[i];
+                  if(s.isLink_) {
+                     shape.push_back(1);
+                     shape.push_back(canon[s.data_]);
+                     shape.push_back(base[s.data_]-b);
+                  }
+                  else if(s.isBucket_) {
+                     const BucketT& bucket = buckets_[s.data_];
+                     shape.push_back(2);
+                     shape.push_back(bucket.size_);
+                     for(std::size_t j = bucket.first_, j_end = j+bucket.size_; j < j_end; ++j)
+                        shape.push_back(bucket_tuples_[j]-b);
+                  }
+                  else if(s.data_ != NO_TUPLE) {
+                     shape.push_back(0);
+                     shape.push_back(s.data_-b);
+                  }
+                  else
+                     shape.push_back(3);
+               }
+               canon[h] = shapes.insert(std::make_pair(shape, h)).first->second;
+            }
+            if(shapes.size() == count)
+               return;
+
+            // the representative of the root becomes header 0
+            std::vector<std::size_t> index(count, std::size_t(NO_TUPLE));
+            std::size_t next = 0;
+            index[canon[0]] = next++;
+            for(std::size_t h = 0; h < count; ++h) {
+               if(canon[h] == h && index[h] == NO_TUPLE)
+                  index[h] = next++;
+            }
+
+            HeaderVectorT headers(next, NodeHeaderT(), headers_.get_allocator());
+            SlotVectorT slots(1, NodeT(), slots_.get_allocator());
+            BucketVectorT buckets(buckets_.get_allocator());
+            IndexVectorT bucket_tuples(bucket_tuples_.get_allocator());
+            for(std::size_t h = 0; h < count; ++h) {
+               if(canon[h] != h)
+                  continue;
+
+               NodeHeaderT n = headers_[h];
+               n.slots_ = next_slot(slots);
+               for(std::size_t i = headers_[h].slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  NodeT s = slots_[i];
+                  if(s.isLink_) 
+                     s.data_ = index[canon[s.data_]] | (base[s.data_]-base[h]) << LINK_BITS;
+                  else if(s.isBucket_) {
+                     BucketT bucket = buckets_[s.data_];
+                     for(std::size_t j = bucket.first_, j_end = j+bucket.size_; j < j_end; ++j)
+                        bucket_tuples.push_back(bucket_tuples_[j]-base[h]);
+                     bucket.first_ = bucket_tuples.size()-bucket.size_;
+                     s.data_ = buckets.size();
+                     buckets.push_back(bucket);
+                  }
+                  else if(s.data_ != NO_TUPLE)
+                     s.data_ = s.data_-base[h];
+                  slots.push_back(s);
+               }
+               headers[index[h]] = n;
+            }
+
+            headers_.swap(headers);
+            slots_.swap(slots);
+            buckets_.swap(buckets);
+            bucket_tuples_.swap(bucket_tuples);
+            link_mask_ = LINK_MASK;
+            root_offset_ = base[0];
+         }
+
+         // Lays out headers and slots in the given node order, the root stays first 
+         // and children keep larger header indexes than their parents.
+         void reorder_nodes(node_order_type order, bool weighted) {
+            std::size_t count = headers_.size();
+            std::vector<std::size_t> weights;
+            if(weighted) {
+               weights.resize(count);
+               for(std::size_t h = count; h-- > 0;) {
+                  for(std::size_t i = headers_[h].slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                     const NodeT& n = slots_[i];
+                     weights[h] += n.isLink_ ? weights[n.data_] : leaf_key_count(n);
+                  }
+               }
+            }
+
+            std::vector<std::size_t> sequence;
+            sequence.reserve(count);
+            if(order == breadth_first_nodes) {
+               sequence.push_back(0);
+               for(std::size_t k = 0; k < sequence.size(); ++k)
+                  append_children(sequence[k], weights, sequence);
+            }
+            else if(order == van_emde_boas_nodes)
+               van_emde_boas(0, max_path_length()+1, weights, sequence);
+            else {
+               std::vector<std::size_t> stack(1, std::size_t(0));
+               while(!stack.empty()) {
+                  std::size_t h = stack.back();
+                  stack.pop_back();
+                  sequence.push_back(h);
+                  std::size_t first = stack.size();
+                  append_children(h, weights, stack);
+                  std::reverse(stack.begin()+first, stack.end());
+               }
+            }
+
+            std::vector<std::size_t> index(count);
+            for(std::size_t k = 0; k < count; ++k)
+               index[sequence[k]] = k;
+
+            HeaderVectorT headers(count, NodeHeaderT(), headers_.get_allocator());
+            SlotVectorT slots(1, NodeT(), slots_.get_allocator());
+            slots.reserve(slots_.size());
+            for(std::size_t k = 0; k < count; ++k) {
+               std::size_t h = sequence[k];
+               NodeHeaderT n = headers_[h];
+               n.slots_ = next_slot(slots);
+               for(std::size_t i = headers_[h].slots_, i_end = i+header_slot_size(h); i < i_end; ++i) {
+                  NodeT s = slots_[i];
+                  if(s.isLink_)
+                     s.data_ = index[s.data_];
+                  slots.push_back(s);
+               }
+               headers[k] = n;
+            }
+            headers_.swap(headers);
+            slots_.swap(slots);
+         }
+
+         // appends the children of a node in slot order, or by descending weight
+         void append_children(std::size_t header, const std::vector<std::size_t>& weights, std::vector<std::size_t>& res) const {
+            std::size_t first = res.size();
+            for(std::size_t i = headers_[header].slots_, i_end = i+header_slot_size(header); i < i_end; ++i) {
+               if(slots_[i].isLink_)
+                  res.push_back(slots_[i].data_);
+            }
+            if(!weights.empty())
+               std::stable_sort(res.begin()+first, res.end(), WeightGreater(weights));
+         }
+
+         // van Emde Boas order of the subtree of header cut below height levels: the 
+         // upper half of the levels, then the subtrees hanging below them. The 
+         // recursion depth is logarithmic in the height.
+         void van_emde_boas(std::size_t header, std::size_t height, const std::vector<std::size_t>& weights, std::vector<std::size_t>& res) const {
+            if(height <= 1) {
+               res.push_back(header);
+               return;
+            }
+            std::size_t top = height/2;
+            van_emde_boas(header, top, weights, res);
+
+            std::vector<std::size_t> level(1, header);
+            std::vector<std::size_t> next;
+            for(std::size_t d = 0; d < top && !level.empty(); ++d) {
+               next.clear();
+               for(std::size_t k = 0; k < level.size(); ++k)
+                  append_children(level[k], weights, next);
+               level.swap(next);
+            }
+            if(!weights.empty())
+               std::stable_sort(level.begin(), level.end(), WeightGreater(weights));
+            for(std::size_t k = 0; k < level.size(); ++k)
+               van_emde_boas(level[k], height-top, weights, res);
+         }
+
+         // The root table replaces the first two lookup steps by one load. The second 
+         // column is the one chosen by most keys below the root's link slots. 
+         void build_root_table(std::size_t max_bytes) {
+            const NodeHeaderT& root = headers_[0];
+            std::size_t rows = root.max_slot_-root.min_slot_+1;
+
+            std::map<std::size_t, std::size_t> weights;
+            for(std::size_t i = 0; i < rows; ++i) {
+               const NodeT& n = slots_[root.slots_+i];
+               if(n.isLink_)
+                  weights[headers_[n.data_].ndx_] += key_count(n.data_);
+            }
+            if(weights.empty())
+               return;
+
+            std::size_t ndx = 0;
+            std::size_t best_weight = 0;
+            for(std::map<std::size_t, std::size_t>::const_iterator iter = weights.begin(); iter != weights.end(); ++iter) {
+               if(iter->second > best_weight) {
+                  best_weight = iter->second;
+                  ndx = iter->first;
+               }
+            }
+
+            // byte interval of the second column over all children using it
+            std::size_t min_slot = 255;
+            std::size_t max_slot = 0;
+            for(std::size_t i = 0; i < rows; ++i) {
+               const NodeHeaderT* child = table_child(slots_[root.slots_+i], ndx);
+               if(child != 0) {
+                  min_slot = std::min<std::size_t>(min_slot, child->min_slot_);
+                  max_slot = std::max<std::size_t>(max_slot, child->max_slot_);
+               }
+            }
+
+            std::size_t width = max_slot-min_slot+1;
+            if(rows*width*sizeof(std::size_t) > max_bytes)
+               return;
+
+            table_.ndx_ = ndx;
+            table_.max_ndx_ = std::max<std::size_t>(root.ndx_, ndx);
+            table_.min_slot_ = min_slot;
+            table_.width_ = width;
+            table_.slots_.resize(rows*width);
+            for(std::size_t i = 0; i < rows; ++i) {
+               const NodeHeaderT* child = table_child(slots_[root.slots_+i], ndx);
+               for(std::size_t j = 0; j < width; ++j) {
+                  std::size_t slot = min_slot+j;
+                  if(child == 0)
+                     table_.slots_[i*width+j] = root.slots_+i;
+                  else if(slot >= child->min_slot_ && slot <= child->max_slot_)
+                     table_.slots_[i*width+j] = child->slots_+slot-child->min_slot_;
+                  else
+                     table_.slots_[i*width+j] = 0;
+               }
+            }
+         }
+
+         HeaderVectorT headers_;
+         SlotVectorT slots_;
+         BucketVectorT buckets_;
+         IndexVectorT bucket_tuples_;
+         RootTableT table_;
+         TupleVectorT* data_;
+         std::size_t depth_;
+         bool inline_keys_;      // leaf slots hold the key in the bits above TUPLE_BITS
+         std::size_t link_mask_;      // LINK_MASK if subtrees are shared, else NO_TUPLE
+         std::size_t root_offset_;    // tuple offset of the root of shared subtrees
+         mutable std::vector<boost::uint32_t> columns_; // char sets of the columns while building
+
+         // releases the growth reserve, the copy keeps the allocator
+         template<class V>
+         static void shrink(V& v) {
+            V(v.begin(), v.end(), v.get_allocator()).swap(v);
+         }
+
+         const TupleVectorT& const_data() const {
+            return *data_;
+         }
+
+         inline const char* key_data(std::size_t tuple) const {
+            return entry_key(*data_, tuple);
+         }
+
+         inline std::size_t key_size(std::size_t tuple) const {
+            return entry_key(*data_, tuple).size();
+         }
+      };
 
+   } // namespace detail
+} // namespace static_map_stuff
 
+#endif
\ No newline at end of file